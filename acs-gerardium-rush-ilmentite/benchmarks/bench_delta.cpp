@@ -0,0 +1,102 @@
+/**
+ * @file bench_delta.cpp
+ * @brief Full versus incremental evaluation of single-gene mutations.
+ *
+ * Every single-gene mutation of a valid 10 and 20 unit circuit (each gene set to every value
+ * 0..n+1) is checked and simulated twice: with Check_Validity + Simulate_Circuit from the cold
+ * start, and with Reanalyse_Circuit from the parent's snapshot. The full validity check is
+ * also timed on its own, since many mutations give invalid circuits that are never simulated.
+ *
+ * Usage: bench_delta [repetitions]
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "CCircuit.h"
+#include "CSimulator.h"
+#include "Delta_Evaluation.h"
+
+int main(int argc, char *argv[])
+{
+    int repetitions = argc > 1 ? std::atoi(argv[1]) : 3;
+
+    std::vector<std::vector<int>> circuits = {
+        {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2},
+        {0, 4, 1, 8, 12, 9, 17, 4, 3, 6, 8, 0, 18, 17, 12, 0, 7, 18, 13, 8, 12, 9, 16, 13, 9, 16, 3, 5, 15, 3, 21,
+         11, 16, 18, 20, 3, 0, 18, 2, 0, 16, 3, 6, 6, 9, 1, 10, 6, 19, 19, 0, 9, 1, 8, 7, 11, 16, 14, 1, 12, 3},
+    };
+
+    std::cout << "units,mutations,valid,full check us,full total us,delta total us,full sweeps,delta sweeps\n";
+    for (std::vector<int> &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        int n = (vector_size - 1) / 3;
+        Circuit_Snapshot parent, child;
+        Analyse_Circuit(vector_size, circuit.data(), parent);
+
+        // All single-gene mutations of the parent
+        std::vector<std::vector<int>> children;
+        std::vector<int> genes;
+        for (int gene = 0; gene < vector_size; gene++)
+        {
+            for (int value = 0; value <= n + 1; value++)
+            {
+                if (value != circuit[gene])
+                {
+                    children.push_back(circuit);
+                    children.back()[gene] = value;
+                    genes.push_back(gene);
+                }
+            }
+        }
+        int mutations = children.size();
+
+        double full_check = 0.0, full_total = 0.0, delta_total = 0.0;
+        long long full_sweeps = 0, delta_sweeps = 0;
+        int valid = 0;
+        for (int r = 0; r < repetitions; r++)
+        {
+            valid = 0;
+            full_sweeps = 0;
+            delta_sweeps = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int c = 0; c < mutations; c++)
+            {
+                valid += Check_Validity(vector_size, children[c].data());
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            full_check += std::chrono::duration<double>(end - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            for (int c = 0; c < mutations; c++)
+            {
+                if (Check_Validity(vector_size, children[c].data()))
+                {
+                    full_sweeps += Simulate_Circuit(vector_size, children[c].data()).iterations;
+                }
+            }
+            end = std::chrono::high_resolution_clock::now();
+            full_total += std::chrono::duration<double>(end - start).count();
+
+            start = std::chrono::high_resolution_clock::now();
+            for (int c = 0; c < mutations; c++)
+            {
+                Reanalyse_Circuit(parent, children[c].data(), &genes[c], 1, child);
+                if (child.valid)
+                {
+                    delta_sweeps += child.result.iterations;
+                }
+            }
+            end = std::chrono::high_resolution_clock::now();
+            delta_total += std::chrono::duration<double>(end - start).count();
+        }
+        double scale = 1e6 / (double(repetitions) * mutations);
+        std::cout << n << "," << mutations << "," << valid << "," << full_check * scale << ","
+                  << full_total * scale << "," << delta_total * scale << "," << full_sweeps << "," << delta_sweeps << "\n";
+    }
+    return 0;
+}
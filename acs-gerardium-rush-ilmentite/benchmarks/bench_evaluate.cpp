@@ -0,0 +1,447 @@
+/**
+ * @file bench_evaluate.cpp
+ * @brief Throughput benchmark for the circuit evaluation.
+ *
+ * Compares the original evaluation loop, which rebuilds a std::vector<CUnit> and allocates the
+ * flow rates of every unit in every iteration, against the reusable SimulationWorkspace.
+ * Both versions skip the file output so only the simulation itself is timed.
+ * A second table compares the sweeps to convergence and the throughput of the solver modes, and
+ * a third one compares evaluating circuits one at a time against the vectorised batch. The last
+ * table compares the dynamic workspace against the simulator specialised for 10 units.
+ * Finally, every single-gene mutation of each circuit is simulated from a cold start and from
+ * the converged flows of its parent, and once more with Circuit_Parameters::abort_below set to a
+ * quantile of their performance, counting the children given up on that would have reached it.
+ * Another table scores each circuit under several plant scenarios, once with a separate
+ * simulation per scenario and once in a single pass of the ScenarioWorkspace. The last one runs
+ * the first sweeps of long recycle chains in single precision, switching to double at several
+ * residuals.
+ *
+ * Usage: bench_evaluate [evaluations per circuit]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "CUnit.h"
+#include "CSimulator.h"
+#include "CircuitSimulator.h"
+
+/**
+ * @brief The evaluation loop as it was before the workspace was introduced.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return The performance value.
+ */
+double legacy_evaluate(int vector_size, int *circuit_vector)
+{
+    struct Circuit_Parameters default_circuit_parameters;
+    struct Calculate_constants constants;
+    struct Initial_flow init_flow;
+    struct Economic_parameters eco;
+
+    double Performance = 0.0;
+    int length = (vector_size - 1) / 3;
+    std::vector<CUnit> units = vector_to_units(circuit_vector, length, init_flow);
+    int i;
+    for (i = 0; i < default_circuit_parameters.max_iterations; i++)
+    {
+        double concentrate_gerardium = 0.0;
+        double concentrate_waste = 0.0;
+
+        #pragma omp parallel for reduction(+:concentrate_gerardium, concentrate_waste)
+        for (int j = 0; j < length; j++)
+        {
+            double tau = calculate_residence_time(constants, units[j].old_flow_W, units[j].old_flow_G);
+            struct Recovery recovery = calculate_recovery(constants, tau);
+            std::vector<double> all_flow_rate = calculate_flow_rate(constants, recovery, units[j].old_flow_G, units[j].old_flow_W);
+
+            if (units[j].conc_num < length)
+            {
+                #pragma omp atomic
+                units[units[j].conc_num].new_flow_G += all_flow_rate[0];
+                #pragma omp atomic
+                units[units[j].conc_num].new_flow_W += all_flow_rate[1];
+            }
+            else if (units[j].conc_num == length)
+            {
+                concentrate_gerardium += all_flow_rate[0];
+                concentrate_waste += all_flow_rate[1];
+            }
+            if (units[j].inter_num < length)
+            {
+                #pragma omp atomic
+                units[units[j].inter_num].new_flow_G += all_flow_rate[2];
+                #pragma omp atomic
+                units[units[j].inter_num].new_flow_W += all_flow_rate[3];
+            }
+            if (units[j].tails_num < length)
+            {
+                #pragma omp atomic
+                units[units[j].tails_num].new_flow_G += all_flow_rate[4];
+                #pragma omp atomic
+                units[units[j].tails_num].new_flow_W += all_flow_rate[5];
+            }
+        }
+
+        int start = circuit_vector[0];
+        units[start].new_flow_G += init_flow.init_Fg;
+        units[start].new_flow_W += init_flow.init_Fw;
+
+        bool converge = true;
+        for (int j = 0; j < length; j++)
+        {
+            double diff_fg = std::abs(units[j].new_flow_G - units[j].old_flow_G) / units[j].old_flow_G;
+            double diff_fw = std::abs(units[j].new_flow_W - units[j].old_flow_W) / units[j].old_flow_W;
+            if ((diff_fg > 1e-6 || diff_fw > 1e-6))
+            {
+                converge = false;
+                break;
+            }
+        }
+
+        if (converge)
+        {
+            Performance = get_performance(concentrate_gerardium, concentrate_waste, eco);
+            break;
+        }
+        for (int j = 0; j < length; j++)
+        {
+            units[j].old_flow_G = units[j].new_flow_G;
+            units[j].old_flow_W = units[j].new_flow_W;
+            units[j].new_flow_G = 0.0;
+            units[j].new_flow_W = 0.0;
+        }
+    }
+
+    if (i == 1000)
+    {
+        Performance = init_flow.init_Fw * eco.penalty;
+    }
+    return Performance;
+}
+
+/**
+ * @brief Times repeated evaluations of one circuit.
+ *
+ * @param evaluate The evaluation to time.
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param repeats The number of evaluations.
+ * @param checksum Accumulates the results so the calls cannot be optimised away.
+ * @return The number of evaluations per second.
+ */
+template <typename Evaluate>
+double evaluations_per_second(Evaluate evaluate, int vector_size, int *circuit_vector, int repeats, double &checksum)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repeats; r++)
+    {
+        checksum += evaluate(vector_size, circuit_vector);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return repeats / elapsed.count();
+}
+
+/**
+ * @brief Lists every circuit differing from the given one in a single unit stream.
+ *
+ * Streams sent back to their own unit are skipped.
+ *
+ * @param circuit The parent circuit vector.
+ * @return The child circuit vectors.
+ */
+std::vector<std::vector<int>> single_gene_children(const std::vector<int> &circuit)
+{
+    int vector_size = circuit.size();
+    int num_units = (vector_size - 1) / 3;
+    std::vector<std::vector<int>> children;
+    for (int gene = 1; gene < vector_size; gene++)
+    {
+        for (int value = 0; value < num_units + 2; value++)
+        {
+            if (value != circuit[gene] && value != (gene - 1) / 3)
+            {
+                children.push_back(circuit);
+                children.back()[gene] = value;
+            }
+        }
+    }
+    return children;
+}
+
+/**
+ * @brief Builds a chain of units with recycle streams, for circuits of any size.
+ *
+ * Each unit sends its concentrate to the next unit, its intermediate back one unit and its
+ * tailings back two. The chain is not a valid circuit, but it converges, slowly, which makes it
+ * a convenient stand-in for large circuits.
+ *
+ * @param num_units The number of units.
+ * @return The circuit vector.
+ */
+std::vector<int> recycle_chain(int num_units)
+{
+    std::vector<int> circuit(3 * num_units + 1, num_units + 1);
+    circuit[0] = 0;
+    for (int i = 0; i < num_units; i++)
+    {
+        circuit[3 * i + 1] = i + 1;
+        if (i >= 1)
+        {
+            circuit[3 * i + 2] = i - 1;
+        }
+        if (i >= 2)
+        {
+            circuit[3 * i + 3] = i - 2;
+        }
+    }
+    return circuit;
+}
+
+int main(int argc, char *argv[])
+{
+    int repeats = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    // Circuits from the simulator tests: 5, 10 and 25 units
+    std::vector<std::vector<int>> circuits = {
+        {0, 1, 3, 2, 4, 4, 3, 1, 3, 6, 1, 1, 0, 5, 1, 1},
+        {1, 3, 5, 8, 0, 2, 4, 8, 3, 3, 4, 4, 0, 6, 0, 5, 10, 6, 6, 7, 7, 7, 2, 8, 2, 9, 9, 9, 5, 0, 11},
+        {3, 16, 14, 11, 2, 16, 2, 4, 1, 0, 1, 4, 4, 5, 5, 5, 7, 6, 6, 8, 8, 7, 6, 2, 8, 12, 9, 9, 10, 15, 10, 13, 7, 15, 14, 10, 12, 9, 11, 13,
+         11, 12, 14, 15, 13, 16, 24, 0, 18, 17, 17, 17, 18, 18, 26, 20, 24, 19, 21, 20, 20, 22, 4, 21, 25, 19, 22, 19, 21, 23, 0, 22, 24, 23, 23, 1}};
+
+    SimulationWorkspace workspace;
+    auto workspace_evaluate = [&workspace](int vector_size, int *circuit_vector)
+    { return workspace.evaluate(vector_size, circuit_vector); };
+
+    double checksum = 0.0;
+    std::cout << "units,before (eval/s),after (eval/s),speedup\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        double before = evaluations_per_second(legacy_evaluate, vector_size, circuit.data(), repeats, checksum);
+        double after = evaluations_per_second(workspace_evaluate, vector_size, circuit.data(), repeats, checksum);
+        std::cout << (vector_size - 1) / 3 << "," << before << "," << after << "," << after / before << "\n";
+    }
+
+    struct Solver
+    {
+        const char *name;
+        Solver_Mode mode;
+    };
+    std::vector<Solver> solvers = {{"jacobi", Solver_Mode::jacobi},
+                                   {"anderson", Solver_Mode::anderson},
+                                   {"gauss_seidel", Solver_Mode::gauss_seidel}};
+
+    std::cout << "\nsolver,units,sweeps,converged,performance,eval/s\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        for (auto &solver : solvers)
+        {
+            Circuit_Parameters parameters;
+            parameters.solver = solver.mode;
+            auto solver_evaluate = [&workspace, &parameters](int vector_size, int *circuit_vector)
+            { return workspace.simulate(vector_size, circuit_vector, parameters).performance; };
+
+            Evaluation_Result result = workspace.simulate(vector_size, circuit.data(), parameters);
+            double throughput = evaluations_per_second(solver_evaluate, vector_size, circuit.data(), repeats, checksum);
+            std::cout << solver.name << "," << (vector_size - 1) / 3 << "," << result.iterations << ","
+                      << result.converged << "," << result.performance << "," << throughput << "\n";
+        }
+    }
+
+    std::cout << "\nunits,single (eval/s),batch (eval/s),speedup\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        std::vector<int> batch;
+        for (int r = 0; r < repeats; r++)
+        {
+            batch.insert(batch.end(), circuit.begin(), circuit.end());
+        }
+        std::vector<double> performances(repeats);
+
+        double single = evaluations_per_second(Evaluate_Circuit, vector_size, circuit.data(), repeats, checksum);
+        auto start = std::chrono::high_resolution_clock::now();
+        Evaluate_Circuits_Batch(vector_size, repeats, batch.data(), performances.data());
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        double batched = repeats / elapsed.count();
+        for (double performance : performances)
+        {
+            checksum += performance;
+        }
+        std::cout << (vector_size - 1) / 3 << "," << single << "," << batched << "," << batched / single << "\n";
+    }
+
+    CircuitSimulator<10> fixed_simulator;
+    auto fixed_evaluate = [&fixed_simulator](int, int *circuit_vector)
+    { return fixed_simulator.simulate(circuit_vector).performance; };
+    std::cout << "\nunits,dynamic (eval/s),fixed (eval/s),speedup\n";
+    {
+        std::vector<int> &circuit = circuits[1];
+        int vector_size = circuit.size();
+        double dynamic = evaluations_per_second(workspace_evaluate, vector_size, circuit.data(), repeats, checksum);
+        double fixed = evaluations_per_second(fixed_evaluate, vector_size, circuit.data(), repeats, checksum);
+        std::cout << (vector_size - 1) / 3 << "," << dynamic << "," << fixed << "," << fixed / dynamic << "\n";
+    }
+
+    std::cout << "\nunits,children,converged,cold sweeps,warm sweeps,max performance difference,cold (eval/s),warm (eval/s)\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        int num_units = (vector_size - 1) / 3;
+        Flow_State parent_state;
+        Simulate_Circuit(vector_size, circuit.data(), Circuit_Parameters(), nullptr, &parent_state);
+
+        std::vector<std::vector<int>> children = single_gene_children(circuit);
+
+        // Sweeps are averaged over the children converging from both starts
+        long converged = 0;
+        long cold_sweeps = 0;
+        long warm_sweeps = 0;
+        double difference = 0.0;
+        for (auto &child : children)
+        {
+            Evaluation_Result cold = Simulate_Circuit(vector_size, child.data());
+            Evaluation_Result warm = Simulate_Circuit(vector_size, child.data(), Circuit_Parameters(), &parent_state);
+            if (cold.converged && warm.converged)
+            {
+                converged++;
+                cold_sweeps += cold.iterations;
+                warm_sweeps += warm.iterations;
+                difference = std::max(difference, std::abs(cold.performance - warm.performance));
+            }
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto &child : children)
+        {
+            checksum += Simulate_Circuit(vector_size, child.data()).performance;
+        }
+        auto middle = std::chrono::high_resolution_clock::now();
+        for (auto &child : children)
+        {
+            checksum += Simulate_Circuit(vector_size, child.data(), Circuit_Parameters(), &parent_state).performance;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> cold_time = middle - start;
+        std::chrono::duration<double> warm_time = end - middle;
+
+        std::cout << num_units << "," << children.size() << "," << converged << "," << double(cold_sweeps) / converged << ","
+                  << double(warm_sweeps) / converged << "," << difference << ","
+                  << children.size() / cold_time.count() << "," << children.size() / warm_time.count() << "\n";
+    }
+    // Thresholds at two quantiles of the children's performance stand in for an elite cutoff
+    std::cout << "\nunits,quantile,threshold,aborted,wrongly aborted,full sweeps,bounded sweeps,full (eval/s),bounded (eval/s)\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        std::vector<std::vector<int>> children = single_gene_children(circuit);
+        std::vector<Evaluation_Result> full(children.size());
+        long full_sweeps = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t c = 0; c < children.size(); c++)
+        {
+            full[c] = Simulate_Circuit(vector_size, children[c].data());
+            full_sweeps += full[c].iterations;
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> full_time = end - start;
+
+        std::vector<double> sorted;
+        for (const Evaluation_Result &result : full)
+        {
+            sorted.push_back(result.performance);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        for (double quantile : {0.8, 0.95})
+        {
+            Circuit_Parameters parameters;
+            parameters.abort_below = sorted[static_cast<size_t>(quantile * (sorted.size() - 1))];
+            long aborted = 0;
+            long wrong = 0;
+            long bounded_sweeps = 0;
+            start = std::chrono::high_resolution_clock::now();
+            for (size_t c = 0; c < children.size(); c++)
+            {
+                Evaluation_Result result = Simulate_Circuit(vector_size, children[c].data(), parameters);
+                aborted += result.aborted;
+                wrong += result.aborted && full[c].performance >= parameters.abort_below;
+                bounded_sweeps += result.iterations;
+                checksum += result.performance;
+            }
+            end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> bounded_time = end - start;
+            std::cout << (vector_size - 1) / 3 << "," << quantile << "," << parameters.abort_below << "," << aborted << ","
+                      << wrong << "," << full_sweeps << "," << bounded_sweeps << "," << children.size() / full_time.count()
+                      << "," << children.size() / bounded_time.count() << "\n";
+        }
+    }
+    // Scenarios with different feed grades, kinetics and prices, all on the default solver
+    std::cout << "\nunits,scenarios,separate (eval/s),one pass (eval/s),speedup\n";
+    for (auto &circuit : circuits)
+    {
+        int vector_size = circuit.size();
+        for (int num_scenarios : {1, 4, 8})
+        {
+            std::vector<Circuit_Parameters> scenarios(num_scenarios);
+            for (int s = 0; s < num_scenarios; s++)
+            {
+                scenarios[s].feed.init_Fg = 8.0 + 0.5 * s;
+                scenarios[s].constants.k_concentrate_gerardium *= 1.0 - 0.03 * s;
+                scenarios[s].eco.price = 100.0 + 5.0 * s;
+            }
+            auto separate_evaluate = [&scenarios](int size, int *circuit_vector)
+            {
+                double worst = INFINITY;
+                for (const Circuit_Parameters &parameters : scenarios)
+                {
+                    worst = std::min(worst, Simulate_Circuit(size, circuit_vector, parameters).performance);
+                }
+                return worst;
+            };
+            auto scenario_evaluate = [&scenarios](int size, int *circuit_vector)
+            { return Evaluate_Circuit_Scenarios(size, circuit_vector, scenarios); };
+            int scenario_repeats = std::max(1, repeats / num_scenarios);
+            double separate = evaluations_per_second(separate_evaluate, vector_size, circuit.data(), scenario_repeats, checksum);
+            double one_pass = evaluations_per_second(scenario_evaluate, vector_size, circuit.data(), scenario_repeats, checksum);
+            std::cout << (vector_size - 1) / 3 << "," << num_scenarios << "," << separate << "," << one_pass << ","
+                      << one_pass / separate << "\n";
+        }
+    }
+
+    // Float flows for the early sweeps, then double down to the tolerance
+    std::cout << "\nunits,single precision until,sweeps,performance,double (eval/s),mixed (eval/s)\n";
+    for (int num_units : {25, 100, 500})
+    {
+        std::vector<int> chain = recycle_chain(num_units);
+        int vector_size = chain.size();
+        int chain_repeats = std::max(1, repeats / num_units);
+        Circuit_Parameters double_parameters;
+        double_parameters.max_iterations = 100000;
+        auto double_evaluate = [&workspace, &double_parameters](int size, int *circuit_vector)
+        { return workspace.simulate(size, circuit_vector, double_parameters).performance; };
+        for (double single_precision_until : {1e-2, 1e-3, 1e-4})
+        {
+            Circuit_Parameters mixed_parameters = double_parameters;
+            mixed_parameters.single_precision_until = single_precision_until;
+            auto mixed_evaluate = [&workspace, &mixed_parameters](int size, int *circuit_vector)
+            { return workspace.simulate(size, circuit_vector, mixed_parameters).performance; };
+            Evaluation_Result result = workspace.simulate(vector_size, chain.data(), mixed_parameters);
+            double full = evaluations_per_second(double_evaluate, vector_size, chain.data(), chain_repeats, checksum);
+            double mixed = evaluations_per_second(mixed_evaluate, vector_size, chain.data(), chain_repeats, checksum);
+            std::cout << num_units << "," << single_precision_until << "," << result.iterations << ","
+                      << result.performance << "," << full << "," << mixed << "\n";
+        }
+    }
+    std::cout << "checksum: " << checksum << std::endl;
+
+    return 0;
+}
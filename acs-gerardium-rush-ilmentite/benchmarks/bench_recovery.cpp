@@ -0,0 +1,116 @@
+/**
+ * @file bench_recovery.cpp
+ * @brief Accuracy and throughput of the unit flow split.
+ *
+ * Compares calculate_residence_time + calculate_recovery + calculate_unit_flows against the
+ * Recovery_Kernel with folded constants, exact and tabulated at several error bounds. The
+ * input flows are spread over the range seen in the test circuits. A second table shows how
+ * the tabulated recoveries change the steady state of a 25 unit circuit.
+ *
+ * Usage: bench_recovery [flow splits per kernel]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "CSimulator.h"
+
+int main(int argc, char *argv[])
+{
+    int samples = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    // Input flows between 0.1 and 200 kg/s of total solids, 1% to 50% gerardium
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<double> log_total(std::log(0.1), std::log(200.0));
+    std::uniform_real_distribution<double> fraction(0.01, 0.5);
+    std::vector<double> flow_G(samples);
+    std::vector<double> flow_W(samples);
+    for (int s = 0; s < samples; s++)
+    {
+        double total = std::exp(log_total(generator));
+        double f = fraction(generator);
+        flow_G[s] = f * total;
+        flow_W[s] = (1.0 - f) * total;
+    }
+
+    Calculate_constants constants;
+    std::vector<Flow_rates> reference(samples);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int s = 0; s < samples; s++)
+    {
+        double tau = calculate_residence_time(constants, flow_W[s], flow_G[s]);
+        Recovery recovery = calculate_recovery(constants, tau);
+        reference[s] = calculate_unit_flows(recovery, flow_G[s], flow_W[s]);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+
+    std::cout << "kernel,error bound,table nodes,max abs error,max rel error,splits/s\n";
+    std::cout << "original,0,0,0,0," << samples / elapsed.count() << "\n";
+
+    double checksum = 0.0;
+    std::vector<double> bounds = {0.0, 1e-4, 1e-6, 1e-8};
+    for (double bound : bounds)
+    {
+        Recovery_Kernel kernel(constants);
+        kernel.tabulate(bound);
+
+        std::vector<Flow_rates> flows(samples);
+        start = std::chrono::high_resolution_clock::now();
+        for (int s = 0; s < samples; s++)
+        {
+            flows[s] = kernel.unit_flows(flow_G[s], flow_W[s]);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+
+        // Errors of the concentrate and intermediate streams relative to the input flow
+        double max_abs = 0.0;
+        double max_rel = 0.0;
+        for (int s = 0; s < samples; s++)
+        {
+            const Flow_rates &a = flows[s];
+            const Flow_rates &b = reference[s];
+            double errors[4] = {std::abs(a.cg - b.cg) / flow_G[s], std::abs(a.cw - b.cw) / flow_W[s],
+                                std::abs(a.ig - b.ig) / flow_G[s], std::abs(a.iw - b.iw) / flow_W[s]};
+            double values[4] = {b.cg / flow_G[s], b.cw / flow_W[s], b.ig / flow_G[s], b.iw / flow_W[s]};
+            for (int k = 0; k < 4; k++)
+            {
+                max_abs = std::max(max_abs, errors[k]);
+                max_rel = std::max(max_rel, errors[k] / values[k]);
+            }
+            checksum += a.cg;
+        }
+        std::cout << (bound > 0.0 ? "tabulated" : "folded") << "," << bound << "," << kernel.table.size() / 4 << ","
+                  << max_abs << "," << max_rel << "," << samples / elapsed.count() << "\n";
+    }
+
+    // Effect on a whole circuit (the 25 unit circuit from the simulator tests)
+    int circuit[76] = {3, 16, 14, 11, 2, 16, 2, 4, 1, 0, 1, 4, 4, 5, 5, 5, 7, 6, 6, 8, 8, 7, 6, 2, 8, 12, 9, 9, 10, 15, 10, 13, 7, 15, 14, 10, 12, 9, 11, 13,
+                       11, 12, 14, 15, 13, 16, 24, 0, 18, 17, 17, 17, 18, 18, 26, 20, 24, 19, 21, 20, 20, 22, 4, 21, 25, 19, 22, 19, 21, 23, 0, 22, 24, 23, 23, 1};
+    std::cout << "\nerror bound,performance,sweeps,eval/s\n";
+    for (double bound : bounds)
+    {
+        Circuit_Parameters parameters;
+        parameters.recovery_table_error = bound;
+        Evaluation_Result result = Simulate_Circuit(76, circuit, parameters);
+
+        int repeats = std::max(1, samples / 1000);
+        start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; r++)
+        {
+            checksum += Simulate_Circuit(76, circuit, parameters).performance;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << bound << "," << result.performance << "," << result.iterations << "," << repeats / elapsed.count() << "\n";
+    }
+    std::cout << "checksum: " << checksum << std::endl;
+
+    return 0;
+}
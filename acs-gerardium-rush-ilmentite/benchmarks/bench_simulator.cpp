@@ -0,0 +1,312 @@
+/**
+ * @file bench_simulator.cpp
+ * @brief Latency, sweeps, allocations and thread scaling of Evaluate_Circuit.
+ *
+ * For every unit count a fixed-seed set of random valid circuits is built by
+ * Random_Valid_Circuit and Evaluate_Circuit is called on each of them repeatedly, from one
+ * thread and then from every requested thread count, each thread timing its own calls. Every
+ * thread count gets the same calls, so the throughput column shows the scaling directly. One CSV
+ * row is written per unit count and thread count:
+ *
+ *     units,threads,circuits,converged,mean sweeps,evaluations,p50 us,p90 us,p99 us,max us,allocations per evaluation,eval/s
+ *
+ * Heap allocations are counted by replacing the global operator new of this program. Each
+ * thread warms its simulator up before the timed calls, so the allocation column should read 0.
+ *
+ * With --compare=file the rows are also checked against the CSV of an earlier run: a row whose
+ * median latency or throughput is more than --slack (default 0.1, 10%) worse, or which now
+ * allocates, is reported on stderr and the program exits with status 1.
+ *
+ * Usage: bench_simulator [--units=5,10,20,50,100,200,500,1000] [--circuits=16]
+ *                        [--evaluations=N] [--threads=1,2,4] [--seed=42] [--compare=file] [--slack=0.1]
+ *
+ * --evaluations is the number of calls per unit count and thread count; by default it shrinks
+ * with the circuit size so that every row takes a similar time.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "CCircuit.h"
+#include "CSimulator.h"
+
+/**
+ * @brief Heap allocations made by any thread of this program.
+ */
+static std::atomic<long> allocations(0);
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *pointer = std::malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+/**
+ * @brief Splits a comma separated list of integers.
+ *
+ * @param text The list.
+ * @return The integers.
+ */
+std::vector<int> parse_list(const std::string &text)
+{
+    std::vector<int> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        values.push_back(std::atoi(item.c_str()));
+    }
+    return values;
+}
+
+/**
+ * @struct Row
+ * @brief The measurements of one unit count and thread count.
+ */
+struct Row
+{
+    double p50_us = 0.0;             /**< Median latency of one evaluation */
+    double eval_per_second = 0.0;    /**< Throughput of all threads together */
+    double allocations = 0.0;        /**< Heap allocations per evaluation */
+};
+
+/**
+ * @brief Reads the rows of an earlier run, keyed by unit count and thread count.
+ *
+ * @param filename The CSV written by an earlier run.
+ * @param rows Receives the rows.
+ * @return True if the file could be read.
+ */
+bool read_rows(const std::string &filename, std::map<std::pair<int, int>, Row> &rows)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, ','))
+        {
+            fields.push_back(field);
+        }
+        if (fields.size() != 12 || fields[0] == "units")
+        {
+            continue;
+        }
+        Row &row = rows[{std::atoi(fields[0].c_str()), std::atoi(fields[1].c_str())}];
+        row.p50_us = std::atof(fields[6].c_str());
+        row.allocations = std::atof(fields[10].c_str());
+        row.eval_per_second = std::atof(fields[11].c_str());
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the q-quantile of sorted values.
+ *
+ * @param sorted The values in increasing order, at least one.
+ * @param q The quantile, between 0 and 1.
+ * @return The value at that quantile.
+ */
+double quantile(const std::vector<double> &sorted, double q)
+{
+    size_t index = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<int> unit_counts = {5, 10, 20, 50, 100, 200, 500, 1000};
+    int num_circuits = 16;
+    int evaluations = 0;
+    unsigned seed = 42;
+    double slack = 0.1;
+    std::string compare;
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+    {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        size_t equals = argument.find('=');
+        std::string key = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+        if (key == "--units")
+            unit_counts = parse_list(value);
+        else if (key == "--circuits")
+            num_circuits = std::atoi(value.c_str());
+        else if (key == "--evaluations")
+            evaluations = std::atoi(value.c_str());
+        else if (key == "--threads")
+            thread_counts = parse_list(value);
+        else if (key == "--seed")
+            seed = std::atoi(value.c_str());
+        else if (key == "--compare")
+            compare = value;
+        else if (key == "--slack")
+            slack = std::atof(value.c_str());
+        else
+        {
+            std::cerr << "Unknown argument " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    std::map<std::pair<int, int>, Row> baseline;
+    if (!compare.empty() && !read_rows(compare, baseline))
+    {
+        std::cerr << "Cannot read " << compare << std::endl;
+        return 1;
+    }
+
+    std::cout << "units,threads,circuits,converged,mean sweeps,evaluations,p50 us,p90 us,p99 us,max us,"
+                 "allocations per evaluation,eval/s\n";
+    int regressions = 0;
+    double checksum = 0.0;
+    for (int num_units : unit_counts)
+    {
+        if (num_units < 2)
+        {
+            continue;
+        }
+        std::mt19937 generator(seed + num_units);
+        std::vector<std::vector<int>> circuits;
+        for (int c = 0; c < num_circuits; c++)
+        {
+            circuits.emplace_back(3 * num_units + 1);
+            Random_Valid_Circuit(3 * num_units + 1, circuits.back().data(), generator);
+        }
+        int vector_size = 3 * num_units + 1;
+
+        // Sweeps to convergence do not depend on the thread count
+        int converged = 0;
+        long sweeps = 0;
+        for (std::vector<int> &circuit : circuits)
+        {
+            Evaluation_Result result = Simulate_Circuit(vector_size, circuit.data());
+            converged += result.converged;
+            sweeps += result.iterations;
+        }
+
+        int calls = evaluations > 0 ? evaluations : std::max(num_circuits, 20000 / num_units);
+        std::vector<double> latencies(calls);
+        for (int threads : thread_counts)
+        {
+            long allocations_before = 0;
+            std::chrono::steady_clock::time_point start;
+
+            #pragma omp parallel num_threads(threads) reduction(+:checksum)
+            {
+                // One untimed call per thread grows the thread-local simulator to this size
+                checksum += Evaluate_Circuit(vector_size, circuits[0].data());
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    allocations_before = allocations.load();
+                    start = std::chrono::steady_clock::now();
+                }
+
+                #pragma omp for schedule(dynamic, 1)
+                for (int call = 0; call < calls; call++)
+                {
+                    int *circuit = circuits[call % num_circuits].data();
+                    auto call_start = std::chrono::steady_clock::now();
+                    checksum += Evaluate_Circuit(vector_size, circuit);
+                    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - call_start;
+                    latencies[call] = elapsed.count();
+                }
+            }
+            std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+            long allocated = allocations.load() - allocations_before;
+
+            std::vector<double> sorted = latencies;
+            std::sort(sorted.begin(), sorted.end());
+            Row row;
+            row.p50_us = quantile(sorted, 0.5);
+            row.eval_per_second = calls / wall.count();
+            row.allocations = double(allocated) / calls;
+            std::cout << num_units << "," << threads << "," << num_circuits << "," << converged << ","
+                      << double(sweeps) / num_circuits << "," << calls << "," << row.p50_us << ","
+                      << quantile(sorted, 0.9) << "," << quantile(sorted, 0.99) << "," << sorted.back() << ","
+                      << row.allocations << "," << row.eval_per_second << std::endl;
+
+            auto previous = baseline.find({num_units, threads});
+            if (previous != baseline.end())
+            {
+                const Row &old = previous->second;
+                bool slower = row.p50_us > (1.0 + slack) * old.p50_us;
+                bool lower = row.eval_per_second < old.eval_per_second / (1.0 + slack);
+                bool allocating = row.allocations > old.allocations;
+                if (slower || lower || allocating)
+                {
+                    std::cerr << "regression at " << num_units << " units, " << threads << " threads: p50 "
+                              << old.p50_us << " -> " << row.p50_us << " us, " << old.eval_per_second << " -> "
+                              << row.eval_per_second << " eval/s, " << old.allocations << " -> "
+                              << row.allocations << " allocations per evaluation" << std::endl;
+                    regressions++;
+                }
+            }
+        }
+    }
+    std::cerr << "checksum: " << checksum << std::endl;
+
+    return regressions > 0 ? 1 : 0;
+}
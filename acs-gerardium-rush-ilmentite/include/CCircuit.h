@@ -8,20 +8,180 @@
 #pragma once
 
 #include "CUnit.h"
+#include <cstdint>
+#include <random>
 #include <vector>
 #include <stack>
 
+/**
+ * @brief The outcome of a validity check: valid, or the first rule the circuit breaks.
+ *
+ * The rules are listed in the order they are checked, so a circuit breaking several of them
+ * reports the first.
+ */
+enum class Validity_Code {
+    valid,                /**< The circuit is valid. */
+    missing_value,        /**< Some value between 0 and the largest one does not appear in the vector. */
+    unreachable_unit,     /**< Some unit cannot be reached from unit 0. */
+    misrouted_outlet,     /**< A stream goes to the wrong outlet, or no stream reaches an outlet. */
+    self_recycle,         /**< A unit sends a stream to itself. */
+    same_destination,     /**< All three streams of a unit go to the same place. */
+    missing_stream,       /**< A stream is negative, or the vector ends before the last unit has all three. */
+    value_too_large,      /**< A stream goes beyond the destinations allowed for it. */
+    tails_to_concentrate, /**< A unit feeding the concentrate outlet receives mostly tailings. */
+    bad_feed              /**< The feed does not go to a unit. */
+};
+
+/**
+ * @brief Names a validity code.
+ *
+ * @param code The code.
+ * @return The name of the code, as written in the enumeration.
+ */
+const char *Validity_Code_Name(Validity_Code code);
+
+/**
+ * @brief Looks for the faults a circuit can show in its own streams, in one scan of the vector.
+ *
+ * Rejects a feed that does not go to a unit, a unit sending a stream to itself, and a stream
+ * that is negative, beyond the tailings outlet, or goes to an outlet its kind may not go to. Each
+ * of those breaks a validity rule, so a circuit it rejects is never valid; a circuit it passes
+ * still needs the full analysis. The scan has no branches, so the compiler vectorises it.
+ * Vectors whose size is not 3 * units + 1 are passed on to the full analysis.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return Validity_Code::valid if no such fault was found, otherwise Validity_Code::bad_feed,
+ *         Validity_Code::self_recycle or Validity_Code::misrouted_outlet, in that order. This
+ *         may differ from the first rule Analyse_Validity reports.
+ */
+Validity_Code Structural_Filter(int vector_size, const int *circuit_vector);
+
+/**
+ * @struct Validity_Statistics
+ * @brief Counters of the validity checks, to see what the structural pre-filter saves.
+ *
+ * Every thread records into its own counters (see Local_Validity_Statistics), so recording needs
+ * no locks. Reading the clock costs about as much as the pre-filter, so only one check in
+ * sample_interval is timed. A timed check the pre-filter rejects is analysed in full as well, to
+ * measure the time the pre-filter saved.
+ */
+struct Validity_Statistics {
+    static constexpr int sample_interval = 64;  /**< One check in this many is timed. */
+
+    long long checks = 0;              /**< Calls of Check_Validity. */
+    long long bad_feed = 0;            /**< Rejected by the pre-filter for the feed. */
+    long long self_recycle = 0;        /**< Rejected by the pre-filter for a self-recycle. */
+    long long misrouted = 0;           /**< Rejected by the pre-filter for a stream out of range or to the wrong outlet. */
+    long long valid = 0;               /**< Found valid by the full analysis. */
+    long long timed = 0;               /**< Checks timed. */
+    double filter_seconds = 0.0;       /**< Time of the pre-filter in the timed checks. */
+    long long timed_rejections = 0;    /**< Timed checks the pre-filter rejected. */
+    double avoided_seconds = 0.0;      /**< Time the full analysis took on those. */
+
+    /**
+     * @brief Counts the checks the pre-filter rejected.
+     *
+     * @return The number of checks that never reached the full analysis.
+     */
+    long long rejected() const { return bad_feed + self_recycle + misrouted; }
+
+    /**
+     * @brief Estimates the time the pre-filter saved, from the timed checks.
+     *
+     * @return The full analysis time avoided on rejected checks, less the time of the pre-filter
+     *         on all checks, in seconds. Zero until a check has been timed.
+     */
+    double seconds_saved() const
+    {
+        double avoided = timed_rejections > 0 ? avoided_seconds / timed_rejections * rejected() : 0.0;
+        double spent = timed > 0 ? filter_seconds / timed * checks : 0.0;
+        return avoided - spent;
+    }
+
+    /**
+     * @brief Adds the counters of another thread or period.
+     *
+     * @param other The counters to add.
+     */
+    void merge(const Validity_Statistics &other)
+    {
+        checks += other.checks;
+        bad_feed += other.bad_feed;
+        self_recycle += other.self_recycle;
+        misrouted += other.misrouted;
+        valid += other.valid;
+        timed += other.timed;
+        filter_seconds += other.filter_seconds;
+        timed_rejections += other.timed_rejections;
+        avoided_seconds += other.avoided_seconds;
+    }
+};
+
+/**
+ * @brief Gets the validity counters of the calling thread.
+ *
+ * Check_Validity records every check here.
+ *
+ * @return The counters of the calling thread.
+ */
+Validity_Statistics &Local_Validity_Statistics();
+
+/**
+ * @brief Sums the validity counters of all threads.
+ *
+ * Reads the counters of other threads without locking them, so call it outside parallel regions.
+ *
+ * @param reset Whether to clear the counters afterwards, so the next call covers a new period.
+ * @return The counters of all threads, including threads that have exited.
+ */
+Validity_Statistics Collect_Validity_Statistics(bool reset = true);
+
 /**
  * @brief Checks the validity of a given circuit vector.
  *
+ * Runs Structural_Filter first and the full analysis only on the circuits it passes, and records
+ * the outcome in Local_Validity_Statistics. Safe to call from many threads at once: each thread
+ * checks with its own Circuit.
+ *
  * @param vector_size The size of the circuit vector.
  * @param circuit_vector The circuit vector.
  * @return True if the circuit vector is valid, false otherwise.
  */
 bool Check_Validity(int vector_size, int *circuit_vector);
 
+/**
+ * @brief Checks the validity of a given circuit vector and tells why it is invalid.
+ *
+ * Gives the same verdict as Check_Validity, which calls it. Safe to call from many threads at once.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return Validity_Code::valid, or the first rule the circuit breaks.
+ */
+Validity_Code Analyse_Validity(int vector_size, int *circuit_vector);
+
+/**
+ * @brief Builds a random circuit that is valid by construction.
+ *
+ * Safe to call from many threads at once, each with its own generator; see Circuit::generate.
+ *
+ * @param vector_size The size of the circuit vector, 3 * units + 1 with at least 2 units.
+ * @param circuit_vector Receives the circuit.
+ * @param generator The source of randomness.
+ * @return True if a circuit was built, false if the size allows no valid circuit.
+ */
+bool Random_Valid_Circuit(int vector_size, int *circuit_vector, std::mt19937 &generator);
+
 /**
  * @brief Represents a circuit of units.
+ *
+ * Check_Validity and analyse work on the vector directly, in a few linear passes over scratch
+ * tables kept in the object. The separate checks below work on the units, which must be set
+ * first; they are kept for testing single rules. All state of a check, including the marks and
+ * outlet flags of the reachability traversal, is kept in the object, so separate objects can
+ * check circuits concurrently. The buffers are only ever resized, so reusing one object for many
+ * checks does not allocate. An object is not thread-safe; keep one per thread.
  */
 struct Circuit
 {
@@ -41,6 +201,71 @@ struct Circuit
      */
     bool Check_Validity(int vector_size, int *circuit_vector);
 
+    /**
+     * @brief Checks the validity of a given circuit vector and tells why it is invalid.
+     *
+     * Does not touch the units.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @return Validity_Code::valid, or the first rule the circuit breaks.
+     */
+    Validity_Code analyse(int vector_size, int *circuit_vector);
+
+    /**
+     * @brief Builds a random circuit that is valid by construction.
+     *
+     * First picks the units that send their concentrate out, each with probability
+     * outlet_probability and at least one. Then grows a spanning tree from unit 0: the other
+     * units, in random order, each take a free stream of a unit placed before them, never the
+     * concentrate of a unit sending it out, and a unit sending its concentrate out never hangs off
+     * a tailings stream. The remaining streams go to random other units, and each tailings stream
+     * leaves with probability outlet_probability; tailings aimed at a unit sending its concentrate
+     * out leave instead, so no such unit receives tailings. Last, one tailings stream is made to
+     * leave if none does, units with three identical streams are repaired, and the feed goes to a
+     * random unit (unit 0 if it would not appear otherwise).
+     *
+     * Every rule of analyse then holds; the result is analysed anyway and rebuilt in the rare case
+     * of a two-unit circuit that needs it.
+     *
+     * @param vector_size The size of the circuit vector, 3 * units + 1 with at least 2 units.
+     * @param circuit_vector Receives the circuit.
+     * @param generator The source of randomness.
+     * @return True if a circuit was built, false if the size allows no valid circuit.
+     */
+    bool generate(int vector_size, int *circuit_vector, std::mt19937 &generator);
+
+    static constexpr double outlet_probability = 0.2; /**< Chance that generate sends a concentrate or tailings stream out. */
+
+    /**
+     * @brief Finds which units have a path to each outlet.
+     *
+     * Follows the streams backwards from the outlets. This is not one of the validity rules: a
+     * valid circuit may have units whose products all end up in one outlet. Afterwards
+     * reaches_concentrate and reaches_tailings tell which units reach which outlet.
+     *
+     * @param vector_size The size of the circuit vector, 3 * units + 1.
+     * @param circuit_vector The circuit vector.
+     * @return True if every unit has a path to both outlets, false otherwise.
+     */
+    bool outlets_reachable(int vector_size, int *circuit_vector);
+
+    /**
+     * @brief Tells if a unit has a path to the concentrate outlet.
+     *
+     * @param unit The unit, as of the last call to outlets_reachable.
+     * @return True if the unit reaches the concentrate outlet.
+     */
+    bool reaches_concentrate(int unit) const;
+
+    /**
+     * @brief Tells if a unit has a path to the tailings outlet.
+     *
+     * @param unit The unit, as of the last call to outlets_reachable.
+     * @return True if the unit reaches the tailings outlet.
+     */
+    bool reaches_tailings(int unit) const;
+
     /**
      * @brief Checks if all units are reachable.
      *
@@ -118,4 +343,31 @@ private:
      * @param unit_num The unit number to start marking from.
      */
     void mark_units(int unit_num);
+
+    /**
+     * @brief Finds the first of the rules on a unit's own streams that a circuit breaks.
+     *
+     * @param num_units The number of units.
+     * @param streams The streams of the units, three per unit.
+     * @return The first rule broken, or Validity_Code::valid if none is.
+     */
+    Validity_Code unit_rule_broken(int num_units, const int *streams);
+
+    bool conc_outlet_reached = false;  /**< Whether the last traversal reached the concentrate outlet. */
+    bool inter_outlet_reached = false; /**< Whether the last traversal reached an intermediate stream leaving the circuit. */
+    bool tails_outlet_reached = false; /**< Whether the last traversal reached the tailings outlet. */
+
+    std::vector<int> padded;           /**< A vector with a truncated last unit, completed with -1. */
+    std::vector<char> value_seen;      /**< Which values appear in the vector, for analyse. */
+    std::vector<int> incoming;         /**< Number of streams entering each unit of interest. */
+    std::vector<int> incoming_tails;   /**< Number of tailings streams entering each unit of interest. */
+    std::vector<int> pending;          /**< Units reached by a traversal but not yet followed. */
+    std::vector<int> predecessor_start;  /**< Where the units sending streams to each unit start in predecessors. */
+    std::vector<int> predecessors;       /**< The units sending a stream to each unit, unit by unit. */
+    std::vector<std::uint64_t> reached_bits;     /**< One bit per unit reached from unit 0 by analyse. */
+    std::vector<std::uint64_t> concentrate_bits; /**< One bit per unit feeding (analyse) or reaching (outlets_reachable) the concentrate outlet. */
+    std::vector<std::uint64_t> tailings_bits;    /**< One bit per unit with a path to the tailings outlet. */
+    std::vector<int> order;                      /**< The units in the order generate places them. */
+    std::vector<char> sends_concentrate;         /**< Which units generate sends to the concentrate outlet. */
+    std::vector<char> tree_stream;               /**< Which streams belong to the spanning tree of generate. */
 };
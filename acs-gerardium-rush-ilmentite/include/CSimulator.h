@@ -4,6 +4,10 @@
  *  This header file defines the function and structures that will be used to evaluate the circuit.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -14,13 +18,13 @@
 #pragma once
 
 /**
- * @struct Circuit_Parameters
- * @brief Parameters for the circuit simulator.
+ * @enum Solver_Mode
+ * @brief Methods for finding the steady state of a circuit.
  */
-struct Circuit_Parameters{
-    double tolerance = 0.1;          /**< Tolerance for the simulation convergence */
-    int max_iterations = 1000;       /**< Maximum number of iterations */
-    // other parameters for your circuit simulator       
+enum class Solver_Mode{
+    jacobi,                          /**< Plain fixed-point iteration: every sweep reads the previous one */
+    anderson,                        /**< Fixed-point iteration with Anderson acceleration */
+    gauss_seidel                     /**< In-place sweep in feed-first breadth-first order */
 };
 
 /**
@@ -55,6 +59,28 @@ struct Calculate_constants{
     double k_inter_waste = 0.0003;          /**< Rate constant for intermediate waste */
 };
 
+/**
+ * @struct Circuit_Parameters
+ * @brief Parameters for the circuit simulator.
+ *
+ * Besides the solver settings this holds the kinetics, feed and economics of the plant, so one
+ * object describes everything a simulation depends on. Circuit_Evaluator builds it from a
+ * configuration file or command line flags.
+ */
+struct Circuit_Parameters{
+    double tolerance = 1e-6;         /**< Largest relative change of a unit flow in a converged sweep */
+    int max_iterations = 1000;       /**< Maximum number of iterations */
+    Solver_Mode solver = Solver_Mode::jacobi; /**< Method used to reach the steady state */
+    int anderson_depth = 5;          /**< Number of previous iterates mixed by Anderson acceleration */
+    bool parallel_units = false;     /**< Split the units of one circuit across OpenMP threads (ignored inside a parallel region) */
+    double recovery_table_error = 0.0; /**< Largest error of tabulated recoveries, or 0 to compute them exactly */
+    double single_precision_until = 0.0; /**< Residual below which plain sweeps switch from float to double flows, or 0 to always use double */
+    double abort_below = -std::numeric_limits<double>::infinity(); /**< Stop once the circuit is predicted to end below this performance */
+    struct Calculate_constants constants; /**< Unit volume, density and rate constants */
+    struct Initial_flow feed;        /**< Flow rates entering the circuit */
+    struct Economic_parameters eco;  /**< Prices used to score the concentrate */
+};
+
 /**
  * @struct Recovery
  * @brief Recovery rates of the materials.
@@ -66,15 +92,921 @@ struct Recovery{
     double inter_waste;              /**< Recovery rate of intermediate waste */
 };
 
+/**
+ * @struct Flow_rates
+ * @brief Product stream flow rates leaving a single unit.
+ */
+struct Flow_rates{
+    double cg;                       /**< Gerardium flow in the concentrate stream */
+    double cw;                       /**< Waste flow in the concentrate stream */
+    double ig;                       /**< Gerardium flow in the intermediate stream */
+    double iw;                       /**< Waste flow in the intermediate stream */
+    double tg;                       /**< Gerardium flow in the tailings stream */
+    double tw;                       /**< Waste flow in the tailings stream */
+};
+
+/**
+ * @struct Flow_State
+ * @brief Input flows of every unit of a circuit, used to warm-start a simulation.
+ *
+ * A child produced by a small mutation usually has a steady state close to its parent's, so
+ * starting from the parent's converged flows saves most of the sweeps. Units without a usable
+ * flow (not positive or not finite) start from the feed flows as in a cold start.
+ */
+struct Flow_State{
+    /**
+     * @brief Checks whether the state holds one flow per unit of a circuit.
+     *
+     * @param num_units The number of units in the circuit.
+     * @return True if the state can start a simulation of the circuit.
+     */
+    bool matches(int num_units) const
+    {
+        return static_cast<int>(flow_G.size()) == num_units && static_cast<int>(flow_W.size()) == num_units;
+    }
+
+    /**
+     * @brief Chooses the starting flow of one unit.
+     *
+     * @param flow The flow stored in the state.
+     * @param cold_flow The flow of a cold start.
+     * @return The stored flow if it is positive and finite, the cold flow otherwise.
+     */
+    static double starting_flow(double flow, double cold_flow)
+    {
+        return flow > 0.0 && std::isfinite(flow) ? flow : cold_flow;
+    }
+
+    std::vector<double> flow_G;      /**< Total input flow of gerardium of each unit */
+    std::vector<double> flow_W;      /**< Total input flow of waste of each unit */
+};
+
+/**
+ * @struct Recovery_Kernel
+ * @brief Residence time, recovery and flow split of a unit with the constants folded in.
+ *
+ * With x = 1 / tau = (Fg + Fw) / (rho * phi * V), every recovery k * tau / (1 + (k_c + k_i) * tau)
+ * becomes k / (x + k_c + k_i), so one division per material covers both of its recoveries.
+ * Optionally the recoveries are interpolated linearly from a table over a uniform tau grid whose
+ * spacing keeps the interpolation error below a given bound; residence times beyond the table
+ * are computed exactly.
+ */
+struct Recovery_Kernel{
+    /**
+     * @brief Folds the constants of the calculation.
+     *
+     * @param constants The constants used in the calculation.
+     */
+    explicit Recovery_Kernel(const Calculate_constants &constants = Calculate_constants());
+
+    /**
+     * @brief Checks whether the kernel was folded from the given constants.
+     *
+     * @param constants The constants used in the calculation.
+     * @return True if the kernel computes with exactly these constants.
+     */
+    bool folds(const Calculate_constants &constants) const
+    {
+        return residence_scale == constants.rho * constants.phi * constants.V &&
+               k_concentrate_gerardium == constants.k_concentrate_gerardium &&
+               k_inter_gerardium == constants.k_inter_gerardium &&
+               k_concentrate_waste == constants.k_concentrate_waste &&
+               k_inter_waste == constants.k_inter_waste;
+    }
+
+    /**
+     * @brief Builds the recovery table, or drops it.
+     *
+     * The grid spacing h satisfies h * h / 8 * max |r''| <= max_error for every recovery r. The
+     * grid covers residence times up to max_tau, limited to a fixed number of nodes.
+     *
+     * @param max_error The largest accepted interpolation error; 0 or less computes exactly.
+     * @param max_tau The largest tabulated residence time; 0 or less covers a total flow of 1.
+     */
+    void tabulate(double max_error, double max_tau = 0.0);
+
+    /**
+     * @brief Calculates the residence time.
+     *
+     * @param Fg Flow rate of gerardium.
+     * @param Fw Flow rate of waste.
+     * @return The residence time.
+     */
+    double residence_time(double Fg, double Fw) const
+    {
+        return residence_scale / std::max(Fg + Fw, 1e-10);
+    }
+
+    /**
+     * @brief Calculates the recovery rates, interpolated if the table covers the residence time.
+     *
+     * @param tau The residence time.
+     * @return The recovery rates.
+     */
+    struct Recovery recovery(double tau) const
+    {
+        if (tau < table_max_tau)
+        {
+            double t = tau * table_inverse_step;
+            int node = static_cast<int>(t);
+            double fraction = t - node;
+            const double *a = &table[4 * node];
+            const double *b = a + 4;
+            return {a[0] + fraction * (b[0] - a[0]), a[1] + fraction * (b[1] - a[1]),
+                    a[2] + fraction * (b[2] - a[2]), a[3] + fraction * (b[3] - a[3])};
+        }
+        double x = 1.0 / tau;
+        double gerardium = 1.0 / (x + k_sum_gerardium);
+        double waste = 1.0 / (x + k_sum_waste);
+        return {k_concentrate_gerardium * gerardium, k_concentrate_waste * waste,
+                k_inter_gerardium * gerardium, k_inter_waste * waste};
+    }
+
+    /**
+     * @brief Splits the input flow of a unit into its three product streams.
+     *
+     * @param Fg Input flow rate of gerardium.
+     * @param Fw Input flow rate of waste.
+     * @return The flow rates of the product streams.
+     */
+    struct Flow_rates unit_flows(double Fg, double Fw) const
+    {
+        double total = std::max(Fg + Fw, 1e-10);
+        if (table_max_tau > 0.0)
+        {
+            struct Recovery r = recovery(residence_scale / total);
+            double cg = Fg * r.concentrate_gerardium;
+            double cw = Fw * r.concentrate_waste;
+            double ig = Fg * r.inter_gerardium;
+            double iw = Fw * r.inter_waste;
+            return {cg, cw, ig, iw, Fg - cg - ig, Fw - cw - iw};
+        }
+        // Fg / (x + k_c + k_i) is the gerardium flow per unit rate constant
+        double x = total * inverse_residence_scale;
+        double gerardium = Fg / (x + k_sum_gerardium);
+        double waste = Fw / (x + k_sum_waste);
+        double cg = k_concentrate_gerardium * gerardium;
+        double cw = k_concentrate_waste * waste;
+        double ig = k_inter_gerardium * gerardium;
+        double iw = k_inter_waste * waste;
+        return {cg, cw, ig, iw, Fg - cg - ig, Fw - cw - iw};
+    }
+
+    double residence_scale;          /**< rho * phi * V, so that tau = residence_scale / total flow */
+    double inverse_residence_scale;  /**< 1 / residence_scale */
+    double k_concentrate_gerardium;  /**< Rate constant for concentrate gerardium */
+    double k_inter_gerardium;        /**< Rate constant for intermediate gerardium */
+    double k_concentrate_waste;      /**< Rate constant for concentrate waste */
+    double k_inter_waste;            /**< Rate constant for intermediate waste */
+    double k_sum_gerardium;          /**< Sum of the gerardium rate constants */
+    double k_sum_waste;              /**< Sum of the waste rate constants */
+
+    double table_error = 0.0;        /**< Error bound the table was built for, 0 without a table */
+    double table_max_tau = 0.0;      /**< Residence times below this are interpolated */
+    double table_inverse_step = 0.0; /**< Inverse spacing of the tau grid */
+    std::vector<double> table;       /**< Recoveries (cg, cw, ig, iw) at each grid node */
+};
+
+/**
+ * @struct Evaluation_Result
+ * @brief Outcome of a single circuit simulation.
+ */
+struct Evaluation_Result{
+    double performance = 0.0;        /**< Monetary value of the concentrate stream */
+    double recovery = 0.0;           /**< Fraction of the fed gerardium reaching the concentrate */
+    double grade = 0.0;              /**< Fraction of gerardium in the concentrate stream */
+    int iterations = 0;              /**< Number of sweeps performed */
+    bool converged = false;          /**< Whether the flow rates reached a steady state */
+    double residual = 0.0;           /**< Largest relative change of a flow rate in the last sweep */
+    bool aborted = false;            /**< Whether the simulation stopped early because it could not reach Circuit_Parameters::abort_below */
+};
+
+/**
+ * @struct Abort_Monitor
+ * @brief Decides when a simulation can stop because its circuit cannot beat a threshold.
+ *
+ * Near a fixed point every sweep shrinks the error by a roughly constant factor rho, so the
+ * performance changes geometrically and its remaining change is at most |delta| rho / (1 - rho).
+ * Once the last window ratios of successive changes agree to within spread, the monitor takes
+ * the largest as rho and gives up on the circuit if its performance plus margin times that
+ * remaining change is below the threshold. Anderson mixing and the transient before the slowest
+ * mode dominates make the flow residual rise and fall, so the residual only serves to spot
+ * circuits that stopped converging: past half the sweep limit, a residual no smaller than the
+ * one residual_baseline samples earlier ends the simulation with the non-convergence penalty.
+ * These are predictions, not proofs; bench_evaluate reports how often they are wrong.
+ */
+struct Abort_Monitor{
+    static constexpr int min_sweeps = 32;          /**< Sweeps before the first decision from the performance */
+    static constexpr int window = 16;              /**< Ratios of successive changes kept for rho */
+    static constexpr double spread = 0.05;         /**< Largest spread of the ratios for the changes to count as geometric */
+    static constexpr double margin = 2.0;          /**< Factor on the predicted remaining change */
+    static constexpr int residual_interval = 32;   /**< Sweeps between residual samples */
+    static constexpr int residual_baseline = 4;    /**< Samples between the two residuals compared */
+
+    /**
+     * @brief Sets up a monitor for one simulation.
+     *
+     * @param parameters The solver settings holding the threshold and sweep limit.
+     * @param penalty The performance of a circuit that does not converge.
+     */
+    Abort_Monitor(const Circuit_Parameters &parameters, double penalty)
+        : threshold(parameters.abort_below), tolerance(parameters.tolerance), max_iterations(parameters.max_iterations),
+          penalty(penalty)
+    {
+    }
+
+    /**
+     * @brief Checks whether a threshold was given.
+     *
+     * @return True if the monitor may stop the simulation.
+     */
+    bool enabled() const
+    {
+        return threshold > -std::numeric_limits<double>::infinity();
+    }
+
+    /**
+     * @brief Checks whether the residual of a sweep should be passed to hopeless.
+     *
+     * @param sweep The number of the sweep, counting from 1.
+     * @return True every residual_interval sweeps.
+     */
+    bool wants_residual(int sweep) const
+    {
+        return sweep % residual_interval == 0;
+    }
+
+    /**
+     * @brief Takes the outcome of a sweep and decides whether to stop.
+     *
+     * @param sweep The number of the sweep, counting from 1.
+     * @param performance The performance the concentrate of this sweep would earn.
+     * @param residual The residual of the sweep if wants_residual(sweep), ignored otherwise.
+     * @return True if the circuit cannot reach the threshold; estimate then holds its predicted performance.
+     */
+    bool hopeless(int sweep, double performance, double residual)
+    {
+        double change = performance - previous_performance;
+        if (sweep > 1 && previous_change != 0.0)
+        {
+            ratios[next_ratio] = std::abs(change) / std::abs(previous_change);
+            next_ratio = (next_ratio + 1) % window;
+            num_ratios = std::min(num_ratios + 1, window);
+        }
+        previous_change = sweep > 1 ? change : 0.0;
+        previous_performance = performance;
+
+        // Only trust rho once the changes shrink by a steady factor; early on the fast modes
+        // still decay and the ratios underestimate the slowest one
+        if (sweep >= min_sweeps && num_ratios == window)
+        {
+            double rho = *std::max_element(ratios, ratios + window);
+            double rho_min = *std::min_element(ratios, ratios + window);
+            if (rho < 1.0 && rho - rho_min <= spread)
+            {
+                double bound = performance + margin * std::abs(change) * rho / (1.0 - rho);
+                if (bound < threshold)
+                {
+                    estimate = bound;
+                    return true;
+                }
+            }
+        }
+
+        if (wants_residual(sweep))
+        {
+            int sample = sweep / residual_interval;
+            double &baseline = residuals[sample % residual_baseline];
+            // Past half the sweep limit, the rate since the baseline predicts how many sweeps are
+            // still needed; a circuit needing more than twice the limit will not converge
+            if (2 * sweep >= max_iterations && baseline > 0.0 && residual > 0.0 && penalty < threshold)
+            {
+                double rate = std::pow(residual / baseline, 1.0 / (residual_baseline * residual_interval));
+                double needed = rate < 1.0 ? std::log(tolerance / residual) / std::log(rate)
+                                           : std::numeric_limits<double>::infinity();
+                if (sweep + needed > 2.0 * max_iterations)
+                {
+                    estimate = penalty;
+                    return true;
+                }
+            }
+            baseline = residual;
+        }
+        return false;
+    }
+
+    double threshold;                         /**< Performance the circuit has to be able to reach */
+    double tolerance;                         /**< Residual of a converged sweep */
+    int max_iterations;                       /**< Sweep limit of the simulation */
+    double penalty;                           /**< Performance of a circuit that does not converge */
+    double estimate = 0.0;                    /**< Predicted performance of a circuit given up on */
+    double previous_performance = 0.0;        /**< Performance after the previous sweep */
+    double previous_change = 0.0;             /**< Change of the performance in the previous sweep */
+    double ratios[window] = {};               /**< Last ratios of successive performance changes */
+    int next_ratio = 0;                       /**< Slot of the next ratio */
+    int num_ratios = 0;                       /**< Number of ratios stored */
+    double residuals[residual_baseline] = {}; /**< Last residual samples, by sample number */
+};
+
+/**
+ * @struct Simulation_Statistics
+ * @brief Counters describing how simulations converged and where their time went.
+ *
+ * Every thread records into its own counters (see Local_Simulation_Statistics), so recording
+ * needs no locks. Sweep counts are kept in power-of-two buckets. When residual sampling is
+ * switched on, the residual after sweep 1, 2, 4, 8, ... is also summed as a logarithm, so the
+ * mean convergence curve of all simulations can be rebuilt from the counters. Sampling is off
+ * by default because the extra residual passes cost about 10% on small circuits.
+ */
+struct Simulation_Statistics{
+    static constexpr int num_buckets = 12;          /**< Bucket b holds 2^b to 2^(b+1)-1 sweeps, the last one everything above */
+
+    long long evaluations = 0;                      /**< Simulations recorded */
+    long long converged = 0;                        /**< Simulations that reached the tolerance */
+    long long sweeps = 0;                           /**< Sweeps over all simulations */
+    int max_sweeps = 0;                             /**< Largest number of sweeps of one simulation */
+    double seconds = 0.0;                           /**< Time spent simulating */
+    double log_final_residual = 0.0;                /**< Sum of log10 of the last residual of simulations that did not converge */
+    long long sweep_histogram[num_buckets] = {};    /**< Simulations per sweep count bucket */
+    double log_residual[num_buckets] = {};          /**< Sum of log10 of the residual after sweep 2^b */
+    long long residual_samples[num_buckets] = {};   /**< Simulations that reached sweep 2^b */
+
+    /**
+     * @brief Finds the histogram bucket of a sweep count.
+     *
+     * @param sweeps The number of sweeps, at least 1.
+     * @return The bucket index.
+     */
+    static int bucket(int sweeps)
+    {
+        int b = 0;
+        while (sweeps > 1 && b < num_buckets - 1)
+        {
+            sweeps >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    /**
+     * @brief Checks whether the residual after a sweep is sampled.
+     *
+     * @param sweep The number of the sweep, counting from 1.
+     * @return True for powers of two up to the last bucket.
+     */
+    static bool is_checkpoint(int sweep)
+    {
+        return (sweep & (sweep - 1)) == 0 && sweep < (1 << num_buckets);
+    }
+
+    /**
+     * @brief Switches the sampling of residuals after sweep 1, 2, 4, 8, ... on or off for all threads.
+     *
+     * @param enabled Whether to sample the residuals.
+     */
+    static void sample_residuals(bool enabled)
+    {
+        residual_sampling().store(enabled, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Checks whether residuals are sampled.
+     *
+     * @return True if sample_residuals(true) was called last.
+     */
+    static bool sampling_residuals()
+    {
+        return residual_sampling().load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records the residual after a checkpoint sweep.
+     *
+     * @param sweep The number of the sweep, a power of two.
+     * @param residual The largest relative change of a flow rate in that sweep.
+     */
+    void record_residual(int sweep, double residual)
+    {
+        int b = bucket(sweep);
+        log_residual[b] += std::log10(std::max(residual, 1e-300));
+        residual_samples[b]++;
+    }
+
+    /**
+     * @brief Records the outcome of a simulation.
+     *
+     * @param result The result of the simulation.
+     * @param elapsed The time the simulation took, in seconds.
+     */
+    void record(const Evaluation_Result &result, double elapsed)
+    {
+        evaluations++;
+        sweeps += result.iterations;
+        max_sweeps = std::max(max_sweeps, result.iterations);
+        seconds += elapsed;
+        sweep_histogram[bucket(std::max(result.iterations, 1))]++;
+        if (result.converged)
+        {
+            converged++;
+        }
+        else
+        {
+            log_final_residual += std::log10(std::max(result.residual, 1e-300));
+        }
+    }
+
+    /**
+     * @brief Adds the counters of another thread or period.
+     *
+     * @param other The counters to add.
+     */
+    void merge(const Simulation_Statistics &other)
+    {
+        evaluations += other.evaluations;
+        converged += other.converged;
+        sweeps += other.sweeps;
+        max_sweeps = std::max(max_sweeps, other.max_sweeps);
+        seconds += other.seconds;
+        log_final_residual += other.log_final_residual;
+        for (int b = 0; b < num_buckets; b++)
+        {
+            sweep_histogram[b] += other.sweep_histogram[b];
+            log_residual[b] += other.log_residual[b];
+            residual_samples[b] += other.residual_samples[b];
+        }
+    }
+
+private:
+    /**
+     * @brief The process-wide residual sampling switch.
+     *
+     * @return The switch.
+     */
+    static std::atomic<bool> &residual_sampling()
+    {
+        static std::atomic<bool> enabled(false);
+        return enabled;
+    }
+};
+
+/**
+ * @struct SimulationWorkspace
+ * @brief Reusable buffers for evaluating circuits without heap allocations.
+ *
+ * The unit connections and flow rates are stored as separate arrays which are only ever grown,
+ * so once a workspace has seen a circuit of a given size, evaluating circuits of that size (or
+ * smaller) does not touch the heap. Each sweep writes the new flows next to the old ones and
+ * the two buffers then trade places, so nothing is copied back. With
+ * Circuit_Parameters::single_precision_until set, plain sweeps keep the flows as float until the
+ * residual falls below it, which halves the memory traffic of the early sweeps of large
+ * circuits, and finish in double. A workspace is not thread-safe; keep one per thread.
+ */
+struct SimulationWorkspace{
+    /**
+     * @brief Evaluates the circuit performance using the buffers of this workspace.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @return The performance value.
+     */
+    double evaluate(int vector_size, int *circuit_vector);
+
+    /**
+     * @brief Simulates the circuit using the buffers of this workspace.
+     *
+     * This is a pure function of the circuit vector: nothing is written to disk.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @param parameters The solver settings.
+     * @param initial_state Flows to start from, or nullptr (or a state of another size) for a cold start.
+     * @param final_state Receives the flows of the last sweep if not nullptr.
+     * @return The performance, recovery, grade and convergence information.
+     */
+    struct Evaluation_Result simulate(int vector_size, int *circuit_vector, const Circuit_Parameters &parameters = Circuit_Parameters(),
+                                      const Flow_State *initial_state = nullptr, Flow_State *final_state = nullptr);
+
+    /**
+     * @brief Loads the unit connections and the initial flow rates into the buffers.
+     *
+     * @param circuit_vector The circuit vector.
+     * @param num_units The number of units in the circuit.
+     * @param init_flow The initial flow rates.
+     * @param initial_state Flows to start from, or nullptr for a cold start.
+     */
+    void load(int *circuit_vector, int num_units, const Initial_flow &init_flow, const Flow_State *initial_state = nullptr);
+
+    /**
+     * @brief Computes the new input flows of all units from the old ones.
+     *
+     * @param init_flow The flow rates entering the circuit at the feed.
+     * @param start The unit receiving the feed.
+     * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+     * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+     * @param parallel Whether to split the units across OpenMP threads.
+     * @return The largest relative change of a flow rate, the residual of the sweep.
+     */
+    double sweep(const Initial_flow &init_flow, int start,
+                 double &concentrate_gerardium, double &concentrate_waste, bool parallel);
+
+    /**
+     * @brief Computes the new input flows of all units from the old ones in single precision.
+     *
+     * Works like sweep on the single_* buffers. The flow split itself is still computed in
+     * double; only the stored flows are rounded to float.
+     *
+     * @param init_flow The flow rates entering the circuit at the feed.
+     * @param start The unit receiving the feed.
+     * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+     * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+     * @param parallel Whether to split the units across OpenMP threads.
+     * @return The largest relative change of a flow rate, the residual of the sweep.
+     */
+    double sweep_single(const Initial_flow &init_flow, int start,
+                        double &concentrate_gerardium, double &concentrate_waste, bool parallel);
+
+    /**
+     * @brief Splits and gathers the flows of one sweep, computing its residual on the way.
+     *
+     * @tparam Real The type the flows are stored in, double or float.
+     * @param init_flow The flow rates entering the circuit at the feed.
+     * @param start The unit receiving the feed.
+     * @param old_G The old gerardium flow of each unit.
+     * @param old_W The old waste flow of each unit.
+     * @param new_G Receives the new gerardium flow of each unit.
+     * @param new_W Receives the new waste flow of each unit.
+     * @param out_G Receives the gerardium flow of the three product streams of each unit.
+     * @param out_W Receives the waste flow of the three product streams of each unit.
+     * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+     * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+     * @param parallel Whether to split the units across OpenMP threads.
+     * @return The largest relative change of a flow rate.
+     */
+    template <typename Real>
+    double sweep_flows(const Initial_flow &init_flow, int start, const Real *old_G, const Real *old_W,
+                       Real *new_G, Real *new_W, Real *out_G, Real *out_W,
+                       double &concentrate_gerardium, double &concentrate_waste, bool parallel);
+
+    /**
+     * @brief Splits the old input flow of every unit into the cached product stream outputs.
+     *
+     * @param parallel Whether to split the units across OpenMP threads.
+     */
+    void compute_outputs(bool parallel);
+
+    /**
+     * @brief Builds the incoming streams of every unit from the loaded connections.
+     */
+    void build_incoming();
+
+    /**
+     * @brief Builds the feed-first unit order for the in-place sweep.
+     *
+     * @param start The unit receiving the feed.
+     */
+    void order_units(int start);
+
+    /**
+     * @brief Computes the new input flows in place, in feed-first order.
+     *
+     * @param init_flow The flow rates entering the circuit at the feed.
+     * @param start The unit receiving the feed.
+     * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+     * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+     * @return The largest relative change of a flow rate, the residual of the sweep.
+     */
+    double sweep_in_place(const Initial_flow &init_flow, int start,
+                          double &concentrate_gerardium, double &concentrate_waste);
+
+    /**
+     * @brief Replaces the old flows with the Anderson-accelerated next iterate.
+     *
+     * @param depth The number of previous iterates to mix.
+     */
+    void anderson_update(int depth);
+
+    Recovery_Kernel kernel;          /**< Folded constants, tabulated if the parameters ask for it */
+    int num_units = 0;               /**< Number of units of the loaded circuit */
+    std::vector<int> conc_num;       /**< Destination of the concentrate stream of each unit */
+    std::vector<int> inter_num;      /**< Destination of the intermediate stream of each unit */
+    std::vector<int> tails_num;      /**< Destination of the tailings stream of each unit */
+    std::vector<double> old_flow_G;  /**< Total old input flow of gerardium of each unit */
+    std::vector<double> old_flow_W;  /**< Total old input flow of waste of each unit */
+    std::vector<double> new_flow_G;  /**< Total new input flow of gerardium of each unit */
+    std::vector<double> new_flow_W;  /**< Total new input flow of waste of each unit */
+
+    std::vector<int> unit_order;     /**< Feed-first order of the units for the in-place sweep */
+    std::vector<char> unit_visited;  /**< Visited flags of the breadth-first search */
+    std::vector<int> incoming_offset; /**< Start of the incoming streams of each unit */
+    std::vector<int> incoming_stream; /**< Incoming streams as 3 * source unit + stream */
+    std::vector<double> output_G;    /**< Gerardium flow of the three product streams of each unit */
+    std::vector<double> output_W;    /**< Waste flow of the three product streams of each unit */
+
+    std::vector<float> single_old_G;    /**< Old gerardium flows of the single precision sweeps */
+    std::vector<float> single_old_W;    /**< Old waste flows of the single precision sweeps */
+    std::vector<float> single_new_G;    /**< New gerardium flows of the single precision sweeps */
+    std::vector<float> single_new_W;    /**< New waste flows of the single precision sweeps */
+    std::vector<float> single_output_G; /**< Gerardium product streams of the single precision sweeps */
+    std::vector<float> single_output_W; /**< Waste product streams of the single precision sweeps */
+
+    int anderson_columns = 0;        /**< Number of stored Anderson history columns */
+    int anderson_next = 0;           /**< Ring buffer slot for the next Anderson history column */
+    bool anderson_has_previous = false; /**< Whether the previous residual is available */
+    std::vector<double> anderson_f;      /**< Current residual g(x) - x */
+    std::vector<double> anderson_f_prev; /**< Previous residual */
+    std::vector<double> anderson_g_prev; /**< Previous sweep result g(x) */
+    std::vector<double> anderson_dF;     /**< History of residual differences, one column per iterate */
+    std::vector<double> anderson_dG;     /**< History of sweep result differences */
+    std::vector<double> anderson_q;      /**< Orthonormalised scaled dF columns */
+    std::vector<double> anderson_r;      /**< Triangular factor of the scaled dF columns */
+    std::vector<int> anderson_used;      /**< History columns kept by the factorisation */
+    std::vector<double> anderson_gamma;  /**< Mixing coefficients */
+    std::vector<double> anderson_weight; /**< Row weights of the mixing problem */
+};
+
+/**
+ * @struct BatchWorkspace
+ * @brief Reusable buffers for simulating many circuits of the same size together.
+ *
+ * The flows are stored unit by unit with one lane per circuit ([unit][lane]), so the residence
+ * time, recovery and flow split of one unit are computed for all lanes in a single vectorised
+ * loop. A lane whose circuit has converged (or run out of iterations) is refilled with the next
+ * circuit of the batch, so the lanes stay busy until the batch is exhausted. A workspace is not
+ * thread-safe; keep one per thread.
+ */
+struct BatchWorkspace{
+    static constexpr int lanes = 8; /**< Number of circuits simulated side by side */
+
+    /**
+     * @brief Simulates a batch of circuits with plain fixed-point sweeps.
+     *
+     * Gives the same results as SimulationWorkspace::simulate with Solver_Mode::jacobi, up to
+     * rounding of the vectorised arithmetic.
+     *
+     * @param vector_size The size of every circuit vector.
+     * @param num_circuits The number of circuits.
+     * @param circuit_vectors The circuit vectors, stored one after another.
+     * @param results Receives one result per circuit.
+     * @param parameters The solver settings.
+     */
+    void simulate(int vector_size, int num_circuits, int *circuit_vectors, Evaluation_Result *results,
+                  const Circuit_Parameters &parameters = Circuit_Parameters());
+
+    /**
+     * @brief Loads a circuit into a lane and resets its flows.
+     *
+     * @param lane The lane to fill.
+     * @param circuit_vector The circuit vector.
+     * @param init_flow The initial flow rates.
+     */
+    void load_lane(int lane, int *circuit_vector, const Initial_flow &init_flow);
+
+    /**
+     * @brief Computes the new input flows of all units in all lanes from the old ones.
+     *
+     * @param kernel The folded constants used in the calculation.
+     * @param init_flow The flow rates entering the circuit at the feed.
+     */
+    void sweep(const Recovery_Kernel &kernel, const Initial_flow &init_flow);
+
+    int num_units = 0;               /**< Number of units of every circuit in the batch */
+    Recovery_Kernel kernel;          /**< Folded constants of the last parameters */
+    std::vector<int> destination;    /**< Destination of each product stream, [3 * unit + stream][lane] */
+    std::vector<double> old_flow_G;  /**< Old input flow of gerardium, [unit][lane] */
+    std::vector<double> old_flow_W;  /**< Old input flow of waste, [unit][lane] */
+    std::vector<double> new_flow_G;  /**< New input flow of gerardium, [unit][lane] */
+    std::vector<double> new_flow_W;  /**< New input flow of waste, [unit][lane] */
+    std::vector<double> output_G;    /**< Gerardium flow of each product stream, [3 * unit + stream][lane] */
+    std::vector<double> output_W;    /**< Waste flow of each product stream, [3 * unit + stream][lane] */
+
+    int start[lanes];                /**< Unit receiving the feed in each lane */
+    int circuit[lanes];              /**< Circuit held by each lane, -1 once the lane is idle */
+    int iterations[lanes];           /**< Sweeps performed on the circuit of each lane */
+    double concentrate_G[lanes];     /**< Gerardium reaching the concentrate in each lane */
+    double concentrate_W[lanes];     /**< Waste reaching the concentrate in each lane */
+    int converged[lanes];            /**< Convergence mask of the last sweep */
+    double residual[lanes];          /**< Largest relative change of a flow rate in the last sweep of each lane */
+};
+
+/**
+ * @enum Scenario_Aggregate
+ * @brief Ways of combining the performances of one circuit under several scenarios.
+ */
+enum class Scenario_Aggregate{
+    worst,                           /**< The lowest performance, for a circuit that has to pay off in every scenario */
+    mean                             /**< The average performance over the scenarios */
+};
+
+/**
+ * @struct ScenarioWorkspace
+ * @brief Reusable buffers for simulating one circuit under several plant scenarios together.
+ *
+ * A scenario is a Circuit_Parameters whose kinetics, feed and economics may differ from the
+ * others. The circuit vector is read once and every stream is routed once for all scenarios; the
+ * flows are stored unit by unit with one lane per scenario ([unit][scenario]), so the flow split
+ * of a unit runs as one vectorised loop over the scenarios with the constants of each scenario
+ * folded as in Recovery_Kernel. Every scenario reports its result at the sweep in which it
+ * converges, so the results match separate simulations up to rounding. A workspace is not
+ * thread-safe; keep one per thread.
+ */
+struct ScenarioWorkspace{
+    /**
+     * @brief Simulates a circuit under every scenario with plain fixed-point sweeps.
+     *
+     * The tolerance and max_iterations of the first scenario apply to all of them; the solver
+     * mode, recovery table and abort threshold are not used.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @param scenarios The parameters of each scenario, at least one.
+     * @param results Receives one result per scenario.
+     */
+    void simulate(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                  std::vector<Evaluation_Result> &results);
+
+    /**
+     * @brief Computes the new input flows of all units in all scenarios from the old ones.
+     *
+     * @param start The unit receiving the feed.
+     */
+    void sweep(int start);
+
+    int num_units = 0;               /**< Number of units of the circuit */
+    int num_scenarios = 0;           /**< Number of scenarios, the lane count */
+    std::vector<int> destination;    /**< Destination of each product stream, 3 * unit + stream */
+    std::vector<double> old_flow_G;  /**< Old input flow of gerardium, [unit][scenario] */
+    std::vector<double> old_flow_W;  /**< Old input flow of waste, [unit][scenario] */
+    std::vector<double> new_flow_G;  /**< New input flow of gerardium, [unit][scenario] */
+    std::vector<double> new_flow_W;  /**< New input flow of waste, [unit][scenario] */
+    std::vector<double> output_G;    /**< Gerardium flow of each product stream, [3 * unit + stream][scenario] */
+    std::vector<double> output_W;    /**< Waste flow of each product stream, [3 * unit + stream][scenario] */
+
+    std::vector<double> inverse_residence_scale; /**< 1 / (rho * phi * V) of each scenario */
+    std::vector<double> k_concentrate_gerardium; /**< Rate constant for concentrate gerardium of each scenario */
+    std::vector<double> k_inter_gerardium;       /**< Rate constant for intermediate gerardium of each scenario */
+    std::vector<double> k_concentrate_waste;     /**< Rate constant for concentrate waste of each scenario */
+    std::vector<double> k_inter_waste;           /**< Rate constant for intermediate waste of each scenario */
+    std::vector<double> k_sum_gerardium;         /**< Sum of the gerardium rate constants of each scenario */
+    std::vector<double> k_sum_waste;             /**< Sum of the waste rate constants of each scenario */
+    std::vector<double> feed_G;                  /**< Gerardium feed of each scenario */
+    std::vector<double> feed_W;                  /**< Waste feed of each scenario */
+
+    std::vector<double> concentrate_G; /**< Gerardium reaching the concentrate in each scenario */
+    std::vector<double> concentrate_W; /**< Waste reaching the concentrate in each scenario */
+    std::vector<double> residual;      /**< Largest relative change of a flow rate in the last sweep of each scenario */
+    std::vector<char> finished;        /**< Whether the result of each scenario is final */
+};
+
 /**
  * @brief Evaluates the circuit performance.
  *
+ * Uses a thread-local simulator, so repeated calls from the same thread do not allocate.
+ *
  * @param vector_size The size of the circuit vector.
  * @param circuit_vector The circuit vector.
  * @return The performance value.
  */
 double Evaluate_Circuit(int vector_size, int *circuit_vector);
 
+/**
+ * @brief Evaluates the circuit performance, giving up once it cannot reach a threshold.
+ *
+ * Runs with Circuit_Parameters::abort_below set to the threshold. A circuit given up on returns
+ * the performance predicted for it, which is below the threshold; any other circuit returns the
+ * same value as Evaluate_Circuit.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param threshold The performance worth simulating for, or -infinity to always finish.
+ * @return The performance value, or its prediction if the simulation was given up.
+ */
+double Evaluate_Circuit_Bounded(int vector_size, int *circuit_vector, double threshold);
+
+/**
+ * @brief Simulates the circuit and returns the full result.
+ *
+ * Uses a thread-local simulator and performs no file I/O, so it is safe to call from many threads
+ * at once. Plain double precision sweeps of circuits whose unit count is listed in
+ * CIRCUIT_FIXED_UNITS run in a CircuitSimulator specialised for that count; all other circuits
+ * use a SimulationWorkspace.
+ *
+ * A warm start from initial_state (for example the converged flows of a parent) usually needs
+ * far fewer sweeps and reaches the same steady state within the convergence tolerance.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param parameters The solver settings.
+ * @param initial_state Flows to start from, or nullptr (or a state of another size) for a cold start.
+ * @param final_state Receives the flows of the last sweep if not nullptr.
+ * @return The performance, recovery, grade and convergence information.
+ */
+struct Evaluation_Result Simulate_Circuit(int vector_size, int *circuit_vector, const Circuit_Parameters &parameters = Circuit_Parameters(),
+                                          const Flow_State *initial_state = nullptr, Flow_State *final_state = nullptr);
+
+/**
+ * @brief Evaluates the performance of many circuits of the same size.
+ *
+ * Uses a thread-local BatchWorkspace and simulates the circuits in vectorised lanes.
+ *
+ * @param vector_size The size of every circuit vector.
+ * @param num_circuits The number of circuits.
+ * @param circuit_vectors The circuit vectors, stored one after another.
+ * @param performances Receives the performance value of each circuit.
+ */
+void Evaluate_Circuits_Batch(int vector_size, int num_circuits, int *circuit_vectors, double *performances);
+
+/**
+ * @brief Simulates many circuits of the same size and returns the full results.
+ *
+ * Plain Jacobi sweeps with exact recoveries run in the vectorised lanes of a thread-local
+ * BatchWorkspace. The circuits are simulated one at a time instead, with every setting honoured,
+ * when another solver mode, abort_below, recovery_table_error, single_precision_until or
+ * parallel_units is set.
+ *
+ * @param vector_size The size of every circuit vector.
+ * @param num_circuits The number of circuits.
+ * @param circuit_vectors The circuit vectors, stored one after another.
+ * @param results Receives one result per circuit.
+ * @param parameters The solver settings.
+ */
+void Simulate_Circuits_Batch(int vector_size, int num_circuits, int *circuit_vectors, Evaluation_Result *results,
+                             const Circuit_Parameters &parameters = Circuit_Parameters());
+
+/**
+ * @brief Simulates one circuit under several scenarios in a single pass.
+ *
+ * Uses a thread-local ScenarioWorkspace; see ScenarioWorkspace::simulate for the settings used.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param scenarios The parameters of each scenario, at least one.
+ * @param results Receives one result per scenario.
+ */
+void Simulate_Circuit_Scenarios(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                                std::vector<Evaluation_Result> &results);
+
+/**
+ * @brief Combines the performances of one circuit under several scenarios.
+ *
+ * @param results The result of each scenario.
+ * @param aggregate How to combine them.
+ * @return The combined performance, or the lowest double if there are no results.
+ */
+double Aggregate_Scenarios(const std::vector<Evaluation_Result> &results, Scenario_Aggregate aggregate);
+
+/**
+ * @brief Evaluates the performance of one circuit under several scenarios in a single pass.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param scenarios The parameters of each scenario, at least one.
+ * @param aggregate How to combine the performances.
+ * @return The combined performance.
+ */
+double Evaluate_Circuit_Scenarios(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                                  Scenario_Aggregate aggregate = Scenario_Aggregate::worst);
+
+/**
+ * @brief Writes the performance, recovery and grade of a result to a file.
+ *
+ * Meant to be called once for the final circuit, not from the optimisation loop.
+ *
+ * @param result The result to write.
+ * @param filename The file to write to.
+ * @return True if the file could be written, false otherwise.
+ */
+bool Write_Performance(const Evaluation_Result &result, const std::string &filename = "./output/performance.dat");
+
+/**
+ * @brief Gets the simulation counters of the calling thread.
+ *
+ * Simulate_Circuit, Simulate_Circuits_Batch and Simulate_Circuit_Scenarios record every simulation here.
+ *
+ * @return The counters of the calling thread.
+ */
+Simulation_Statistics &Local_Simulation_Statistics();
+
+/**
+ * @brief Sums the simulation counters of all threads.
+ *
+ * Reads the counters of other threads without locking them, so call it outside parallel
+ * regions, for example between two generations of the genetic algorithm.
+ *
+ * @param reset Whether to clear the counters afterwards, so the next call covers a new period.
+ * @return The counters of all threads, including threads that have exited.
+ */
+Simulation_Statistics Collect_Simulation_Statistics(bool reset = true);
+
+/**
+ * @brief Writes one CSV row of simulation counters per period, for example per generation.
+ *
+ * @param periods The counters of each period.
+ * @param filename The file to write to.
+ * @return True if the file could be written, false otherwise.
+ */
+bool Write_Simulation_Statistics(const std::vector<Simulation_Statistics> &periods,
+                                 const std::string &filename = "./output/convergence.csv");
+
 /**
  * @brief Calculates the residence time.
  *
@@ -105,6 +1037,16 @@ struct Recovery calculate_recovery(const Calculate_constants& constants, double
  */
 std::vector<double> calculate_flow_rate(const Calculate_constants& constants, Recovery& recovery, double init_Fg, double init_Fw);
 
+/**
+ * @brief Calculates the flow rates without allocating.
+ *
+ * @param recovery The recovery rates.
+ * @param init_Fg Input flow rate of gerardium.
+ * @param init_Fw Input flow rate of waste.
+ * @return The flow rates of the three product streams.
+ */
+struct Flow_rates calculate_unit_flows(const Recovery& recovery, double init_Fg, double init_Fw);
+
 /**
  * @brief Gets the performance of the circuit.
  *
@@ -0,0 +1,220 @@
+/**
+ * @file CircuitSimulator.h
+ * @brief Circuit simulator specialised at compile time for a fixed number of units.
+ *
+ * Production runs use one unit count per campaign, so the unit count can be a template
+ * parameter. All buffers are then std::array members and every loop has a constant trip
+ * count, which lets the compiler unroll the unit loops and keep the flows in registers.
+ * Simulate_Circuit dispatches to these simulators for the unit counts listed in the
+ * CIRCUIT_FIXED_UNITS CMake option and uses SimulationWorkspace for every other size.
+ */
+
+#pragma once
+
+#include <array>
+#include <cmath>
+
+#include "CSimulator.h"
+
+/**
+ * @struct CircuitSimulator
+ * @brief Plain fixed-point simulator for circuits of exactly NUnits units.
+ *
+ * Gives the same results as SimulationWorkspace::simulate with Solver_Mode::jacobi: the
+ * product streams are added to their destinations in increasing source unit order, the same
+ * order as the gather of the dynamic simulator. The old and new flows live in two buffers that
+ * trade places after every sweep. Not thread-safe; keep one per thread.
+ *
+ * @tparam NUnits The number of units in the circuit.
+ */
+template <int NUnits>
+struct CircuitSimulator{
+    static_assert(NUnits > 0, "a circuit needs at least one unit");
+
+    static constexpr int vector_size = 3 * NUnits + 1; /**< Size of the circuit vector */
+
+    /**
+     * @brief Simulates a circuit of NUnits units.
+     *
+     * @param circuit_vector The circuit vector, of vector_size entries.
+     * @param parameters The solver settings; the solver mode is ignored.
+     * @param initial_state Flows to start from, or nullptr (or a state of another size) for a cold start.
+     * @param final_state Receives the flows of the last sweep if not nullptr.
+     * @return The performance, recovery, grade and convergence information.
+     */
+    struct Evaluation_Result simulate(const int *circuit_vector, const Circuit_Parameters &parameters = Circuit_Parameters(),
+                                      const Flow_State *initial_state = nullptr, Flow_State *final_state = nullptr)
+    {
+        const Initial_flow &init_flow = parameters.feed;
+        const Economic_parameters &eco = parameters.eco;
+        if (!kernel.folds(parameters.constants))
+        {
+            kernel = Recovery_Kernel(parameters.constants);
+        }
+
+        struct Evaluation_Result result;
+
+        int start = circuit_vector[0];
+        for (int k = 0; k < 3 * NUnits; k++)
+        {
+            destination[k] = circuit_vector[k + 1];
+        }
+        old = 0;
+        flow_G[old].fill(init_flow.init_Fg);
+        flow_W[old].fill(init_flow.init_Fw);
+        flow_G[1 - old].fill(0.0);
+        flow_W[1 - old].fill(0.0);
+        if (initial_state != nullptr && initial_state->matches(NUnits))
+        {
+            for (int j = 0; j < NUnits; j++)
+            {
+                flow_G[old][j] = Flow_State::starting_flow(initial_state->flow_G[j], init_flow.init_Fg);
+                flow_W[old][j] = Flow_State::starting_flow(initial_state->flow_W[j], init_flow.init_Fw);
+            }
+        }
+
+        Simulation_Statistics &statistics = Local_Simulation_Statistics();
+        bool sample_residuals = Simulation_Statistics::sampling_residuals();
+        Abort_Monitor monitor(parameters, init_flow.init_Fw * eco.penalty);
+
+        int i;
+        for (i = 0; i < parameters.max_iterations; i++)
+        {
+            double concentrate_gerardium = 0.0;
+            double concentrate_waste = 0.0;
+            double sweep_residual = sweep(kernel, init_flow, start, concentrate_gerardium, concentrate_waste);
+
+            // Judge if the circuit has converged
+            bool converge = sweep_residual <= parameters.tolerance;
+
+            result.residual = sweep_residual;
+            if (sample_residuals && Simulation_Statistics::is_checkpoint(i + 1))
+            {
+                statistics.record_residual(i + 1, sweep_residual);
+            }
+
+            // Calculate the recovery and grade of the circuit
+            result.recovery = concentrate_gerardium / init_flow.init_Fg;
+            double concentrate_total = concentrate_gerardium + concentrate_waste;
+            result.grade = concentrate_total > 0.0 ? concentrate_gerardium / concentrate_total : 0.0;
+
+            if (converge)
+            {
+                result.performance = get_performance(concentrate_gerardium, concentrate_waste, eco);
+                result.converged = true;
+                break;
+            }
+
+            // Give up on circuits that cannot reach the threshold
+            if (monitor.enabled())
+            {
+                double monitored_residual = monitor.wants_residual(i + 1) ? sweep_residual : 0.0;
+                if (monitor.hopeless(i + 1, get_performance(concentrate_gerardium, concentrate_waste, eco), monitored_residual))
+                {
+                    result.aborted = true;
+                    break;
+                }
+            }
+
+            // The new flows become the old ones without being copied
+            old = 1 - old;
+        }
+        result.iterations = result.converged || result.aborted ? i + 1 : i;
+
+        // If the circuit does not converge, set the performance to the feed waste times the penalty
+        if (result.aborted)
+        {
+            result.performance = monitor.estimate;
+        }
+        else if (!result.converged)
+        {
+            result.performance = init_flow.init_Fw * eco.penalty;
+        }
+
+        if (final_state != nullptr)
+        {
+            // Unless the loop stopped early, the last sweep has already moved to the old buffers
+            int last = result.converged || result.aborted || i == 0 ? 1 - old : old;
+            final_state->flow_G.assign(flow_G[last].begin(), flow_G[last].end());
+            final_state->flow_W.assign(flow_W[last].begin(), flow_W[last].end());
+        }
+
+        return result;
+    }
+
+    /**
+     * @brief Computes the new input flows of all units from the old ones.
+     *
+     * @param kernel The folded constants used in the calculation.
+     * @param init_flow The flow rates entering the circuit at the feed.
+     * @param start The unit receiving the feed.
+     * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+     * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+     * @return The largest relative change of a flow rate, the residual of the sweep.
+     */
+    double sweep(const Recovery_Kernel &kernel, const Initial_flow &init_flow, int start,
+                 double &concentrate_gerardium, double &concentrate_waste)
+    {
+        const std::array<double, NUnits> &old_G = flow_G[old];
+        const std::array<double, NUnits> &old_W = flow_W[old];
+        std::array<double, NUnits> &new_G = flow_G[1 - old];
+        std::array<double, NUnits> &new_W = flow_W[1 - old];
+
+        // Split the old flow of every unit into its product streams
+        for (int j = 0; j < NUnits; j++)
+        {
+            struct Flow_rates flows = kernel.unit_flows(old_G[j], old_W[j]);
+            output_G[3 * j] = flows.cg;
+            output_W[3 * j] = flows.cw;
+            output_G[3 * j + 1] = flows.ig;
+            output_W[3 * j + 1] = flows.iw;
+            output_G[3 * j + 2] = flows.tg;
+            output_W[3 * j + 2] = flows.tw;
+        }
+
+        for (int j = 0; j < NUnits; j++)
+        {
+            new_G[j] = j == start ? init_flow.init_Fg : 0.0;
+            new_W[j] = j == start ? init_flow.init_Fw : 0.0;
+        }
+
+        // Route every product stream to its destination
+        double conc_G = 0.0;
+        double conc_W = 0.0;
+        for (int k = 0; k < 3 * NUnits; k++)
+        {
+            int d = destination[k];
+            if (d >= 0 && d < NUnits)
+            {
+                new_G[d] += output_G[k];
+                new_W[d] += output_W[k];
+            }
+            else if (k % 3 == 0 && d == NUnits)
+            {
+                conc_G += output_G[k];
+                conc_W += output_W[k];
+            }
+        }
+        concentrate_gerardium = conc_G;
+        concentrate_waste = conc_W;
+
+        // Relative change of every flow; one that is not a number does not count, as in the original test
+        double largest = 0.0;
+        for (int j = 0; j < NUnits; j++)
+        {
+            double diff_fg = std::abs(new_G[j] - old_G[j]) / old_G[j];
+            double diff_fw = std::abs(new_W[j] - old_W[j]) / old_W[j];
+            largest = diff_fg > largest ? diff_fg : largest;
+            largest = diff_fw > largest ? diff_fw : largest;
+        }
+        return largest;
+    }
+
+    Recovery_Kernel kernel;                    /**< Folded constants of the last parameters */
+    std::array<int, 3 * NUnits> destination;   /**< Destination of each product stream, 3 * unit + stream */
+    std::array<double, NUnits> flow_G[2];      /**< Total input flow of gerardium of each unit, old and new */
+    std::array<double, NUnits> flow_W[2];      /**< Total input flow of waste of each unit, old and new */
+    int old = 0;                               /**< Index of the buffers holding the old flows */
+    std::array<double, 3 * NUnits> output_G;   /**< Gerardium flow of each product stream */
+    std::array<double, 3 * NUnits> output_W;   /**< Waste flow of each product stream */
+};
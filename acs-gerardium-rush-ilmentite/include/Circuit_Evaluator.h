@@ -0,0 +1,175 @@
+/**
+ * @file Circuit_Evaluator.h
+ * @brief Circuit evaluation with parameters read once from a configuration.
+ *
+ * Evaluate_Circuit always simulates the default plant. A Circuit_Evaluator holds one
+ * Circuit_Parameters, built from an INI file and command line flags, and is passed to the
+ * genetic algorithm as its objective, so ore prices, kinetics and solver settings can be varied
+ * without recompiling.
+ *
+ * Every setting has a key of the form section.name:
+ *
+ *     [solver]     tolerance, max_iterations, method (jacobi, anderson or gauss_seidel),
+ *                  anderson_depth, parallel_units, recovery_table_error,
+ *                  single_precision_until
+ *     [constants]  rho, phi, V, k_concentrate_gerardium, k_inter_gerardium,
+ *                  k_concentrate_waste, k_inter_waste
+ *     [feed]       init_Fg, init_Fw
+ *     [economics]  price, penalty
+ *
+ * In an INI file the name goes below its [section] header as name = value; lines starting with
+ * # or ; are comments. On the command line a setting is --section.name=value, and
+ * --config=file reads a file at that point, so later flags override it.
+ *
+ * A Scenario_Evaluator scores a circuit under several such parameter sets at once, for
+ * optimising against a range of feed grades, kinetics or prices.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CSimulator.h"
+
+/**
+ * @struct Circuit_Evaluator
+ * @brief Objective function simulating circuits with fixed parameters.
+ *
+ * Calls only read the parameters and simulate in the thread-local simulators, so one evaluator
+ * can be shared by all threads.
+ */
+struct Circuit_Evaluator{
+    /**
+     * @brief Creates an evaluator for the given parameters.
+     *
+     * @param parameters The solver settings, kinetics, feed and economics to simulate with.
+     */
+    explicit Circuit_Evaluator(const Circuit_Parameters &parameters = Circuit_Parameters())
+        : parameters(parameters)
+    {
+    }
+
+    /**
+     * @brief Simulates a circuit and returns the full result.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @return The performance, recovery, grade and convergence information.
+     */
+    struct Evaluation_Result simulate(int vector_size, int *circuit_vector) const;
+
+    /**
+     * @brief Evaluates the performance of a circuit.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @return The performance value.
+     */
+    double operator()(int vector_size, int *circuit_vector) const;
+
+    /**
+     * @brief Evaluates the performance of a circuit, giving up once it cannot reach a threshold.
+     *
+     * Works like Evaluate_Circuit_Bounded, so the evaluator can be passed to optimize_bounded.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @param threshold The performance worth simulating for, or -infinity to always finish.
+     * @return The performance value, or its prediction if the simulation was given up.
+     */
+    double operator()(int vector_size, int *circuit_vector, double threshold) const;
+
+    Circuit_Parameters parameters;   /**< Parameters of every simulation */
+};
+
+/**
+ * @struct Scenario_Evaluator
+ * @brief Objective function scoring a circuit over several plant scenarios at once.
+ *
+ * Each call simulates the circuit under every scenario in one pass of a ScenarioWorkspace and
+ * combines the performances, by default taking the worst one. Like Circuit_Evaluator it can be
+ * shared by all threads.
+ */
+struct Scenario_Evaluator{
+    /**
+     * @brief Creates an evaluator combining the scenarios with a built-in aggregate.
+     *
+     * @param scenarios The parameters of each scenario, at least one.
+     * @param aggregate How to combine the performances.
+     */
+    explicit Scenario_Evaluator(const std::vector<Circuit_Parameters> &scenarios,
+                                Scenario_Aggregate aggregate = Scenario_Aggregate::worst);
+
+    /**
+     * @brief Creates an evaluator combining the scenarios with a user-supplied aggregate.
+     *
+     * @param scenarios The parameters of each scenario, at least one.
+     * @param aggregate Maps the result of every scenario, in order, to one fitness.
+     */
+    Scenario_Evaluator(const std::vector<Circuit_Parameters> &scenarios,
+                       std::function<double(const std::vector<Evaluation_Result> &)> aggregate);
+
+    /**
+     * @brief Simulates a circuit under every scenario.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @param results Receives one result per scenario.
+     */
+    void simulate(int vector_size, int *circuit_vector, std::vector<Evaluation_Result> &results) const;
+
+    /**
+     * @brief Evaluates the combined performance of a circuit.
+     *
+     * @param vector_size The size of the circuit vector.
+     * @param circuit_vector The circuit vector.
+     * @return The performances of the scenarios, combined.
+     */
+    double operator()(int vector_size, int *circuit_vector) const;
+
+    std::vector<Circuit_Parameters> scenarios;  /**< Parameters of each scenario */
+    std::function<double(const std::vector<Evaluation_Result> &)> aggregate; /**< Combines the results */
+};
+
+/**
+ * @brief Sets one parameter from its key and textual value.
+ *
+ * @param parameters The parameters to change.
+ * @param key The key of the setting, section.name.
+ * @param value The new value.
+ * @param error Receives a message if the key is unknown or the value cannot be read.
+ * @return True if the parameter was set.
+ */
+bool Set_Circuit_Parameter(Circuit_Parameters &parameters, const std::string &key, const std::string &value,
+                           std::string &error);
+
+/**
+ * @brief Reads parameters from an INI file.
+ *
+ * Settings missing from the file keep their current values.
+ *
+ * @param filename The file to read.
+ * @param parameters The parameters to change.
+ * @param error Receives a message naming the file and line if reading fails.
+ * @return True if the file was read and every setting in it was valid.
+ */
+bool Read_Circuit_Config(const std::string &filename, Circuit_Parameters &parameters, std::string &error);
+
+/**
+ * @brief Reads parameters from command line flags.
+ *
+ * Applies --config=file and --section.name=value flags in order. Every other argument, except
+ * argv[0], is passed on in remaining for the caller to handle; that includes --name=value flags
+ * whose name has no section.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param parameters The parameters to change.
+ * @param remaining Receives the arguments that are not parameters.
+ * @param error Receives a message if a flag or configuration file is invalid.
+ * @return True if every parameter flag was valid.
+ */
+bool Parse_Circuit_Arguments(int argc, char *argv[], Circuit_Parameters &parameters,
+                             std::vector<std::string> &remaining, std::string &error);
@@ -0,0 +1,92 @@
+/**
+ * @file Delta_Evaluation.h
+ * @brief Incremental validity checking and simulation of mutated circuits.
+ *
+ * A mutation usually changes one or two genes of a circuit vector, yet Check_Validity and
+ * Evaluate_Circuit look at the whole circuit again. A Circuit_Snapshot keeps the counts the
+ * validity checks are built from, together with the converged flows of the circuit, so a child
+ * that differs in a few genes is checked by updating those counts and simulated from its
+ * parent's steady state.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "CSimulator.h"
+
+/**
+ * @struct Circuit_Snapshot
+ * @brief Validity tables, result and flows of an analysed circuit.
+ *
+ * Every check of Check_Validity except reachability only depends on counts that one gene
+ * changes by at most one, so a change is applied in constant time. Reachability from unit 0 is
+ * recomputed only when a stream between two units was removed, or when the parent already had
+ * unreachable units. Genes outside 0..n+1 (and vectors whose size is not 3n+1) are checked with
+ * the full Check_Validity, so the outcome is always the same as for a fresh check.
+ */
+struct Circuit_Snapshot{
+    int vector_size = 0;             /**< Size of the circuit vector */
+    int num_units = 0;               /**< Number of units in the circuit */
+    std::vector<int> genes;          /**< The circuit vector */
+
+    std::vector<int> value_count;    /**< Occurrences of each value 0..n+1 in the vector */
+    int max_value = 0;               /**< Largest value 0..n+1 occurring in the vector */
+    int missing_values = 0;          /**< Values below max_value that do not occur */
+    int out_of_range = 0;            /**< Genes outside 0..n+1, which need the full check */
+    std::vector<int> incoming;       /**< Streams entering each unit */
+    std::vector<int> incoming_tails; /**< Tailings streams entering each unit */
+    int invalid_units = 0;           /**< Units failing a check that only looks at their own streams */
+    int tail_heavy_units = 0;        /**< Units feeding the concentrate outlet while fed mostly by tailings */
+    int concentrate_units = 0;       /**< Units whose concentrate stream reaches the concentrate outlet */
+    int tailings_units = 0;          /**< Units whose tailings stream reaches the tailings outlet */
+    int reachable_units = 0;         /**< Units reachable from unit 0 */
+    std::vector<int> search_queue;   /**< Buffer of the breadth-first search */
+    std::vector<char> search_mark;   /**< Visited flags of the breadth-first search */
+
+    bool valid = false;              /**< Whether the circuit passes Check_Validity */
+    double fitness = 0.0;            /**< Performance of a valid circuit, the lowest double otherwise */
+    struct Evaluation_Result result; /**< Result of the last simulation */
+    Flow_State flows;                /**< Flows of the last simulation, the warm start for children */
+    bool flows_converged = false;    /**< Whether flows hold a converged steady state */
+};
+
+/**
+ * @brief Checks and simulates a circuit from scratch, filling a snapshot for its children.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param snapshot Receives the analysis of the circuit.
+ * @param parameters The solver settings.
+ */
+void Analyse_Circuit(int vector_size, int *circuit_vector, Circuit_Snapshot &snapshot,
+                     const Circuit_Parameters &parameters = Circuit_Parameters());
+
+/**
+ * @brief Checks and simulates a circuit that differs from an analysed parent in a few genes.
+ *
+ * Gives the same validity as Check_Validity. A valid child is simulated starting from the
+ * parent's flows if those converged, so its performance matches Evaluate_Circuit within the
+ * convergence tolerance (a circuit needing close to max_iterations sweeps may converge on one
+ * side of the cap only).
+ * The child may be the parent itself, which applies the change in place.
+ *
+ * @param parent The analysis of the parent circuit.
+ * @param circuit_vector The child circuit vector, of the parent's size.
+ * @param changed_genes Indices of the genes that may differ from the parent.
+ * @param num_changed The number of indices.
+ * @param child Receives the analysis of the child circuit.
+ * @param parameters The solver settings.
+ */
+void Reanalyse_Circuit(const Circuit_Snapshot &parent, int *circuit_vector, const int *changed_genes, int num_changed,
+                       Circuit_Snapshot &child, const Circuit_Parameters &parameters = Circuit_Parameters());
+
+/**
+ * @brief Lists the genes in which two circuit vectors differ.
+ *
+ * @param vector_size The size of the circuit vectors.
+ * @param parent The parent circuit vector.
+ * @param child The child circuit vector.
+ * @param changed_genes Receives the indices of the differing genes.
+ */
+void Changed_Genes(int vector_size, const int *parent, const int *child, std::vector<int> &changed_genes);
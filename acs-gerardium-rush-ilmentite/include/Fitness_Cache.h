@@ -0,0 +1,129 @@
+/**
+ * @file Fitness_Cache.h
+ * @brief Header for the fitness memoization cache of the genetic algorithm.
+ *
+ * Elitism copies the best individuals unchanged into the next generation and crossover often
+ * reproduces vectors that were already evaluated. The cache remembers the fitness of recently
+ * seen vectors so they are not simulated again.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class Fitness_Cache
+ * @brief Thread-safe, bounded map from an individual to its fitness.
+ *
+ * Entries are spread over independently locked shards by a hash of the whole vector, so
+ * threads evaluating different individuals rarely wait for each other. Each shard holds a
+ * fixed number of slots and evicts with the CLOCK algorithm: a hit marks its slot as
+ * referenced, and the clock hand skips (and clears) referenced slots before evicting one.
+ */
+class Fitness_Cache
+{
+public:
+    /**
+     * @struct Statistics
+     * @brief Lookup counts since the cache was created.
+     */
+    struct Statistics {
+        long long hits = 0;      ///< Lookups that found the individual.
+        long long misses = 0;    ///< Lookups that did not.
+
+        /**
+         * @brief Fraction of lookups that were hits.
+         *
+         * @return The hit rate, or 0 without lookups.
+         */
+        double hit_rate() const { return hits + misses > 0 ? double(hits) / double(hits + misses) : 0.0; }
+    };
+
+    /**
+     * @brief Constructs a cache holding at most capacity individuals.
+     *
+     * @param capacity The maximum number of cached individuals; 0 disables the cache.
+     * @param num_shards The number of independently locked shards.
+     */
+    Fitness_Cache(int capacity, int num_shards = 16);
+
+    /**
+     * @brief Checks whether the cache can hold any individual.
+     *
+     * @return True if the capacity is not zero.
+     */
+    bool enabled() const { return !shards.empty(); }
+
+    /**
+     * @brief Looks up the fitness of an individual.
+     *
+     * @param vector_size The size of the individual.
+     * @param vector The individual.
+     * @param fitness Receives the cached fitness on a hit.
+     * @return True on a hit, false otherwise.
+     */
+    bool lookup(int vector_size, const int *vector, double &fitness);
+
+    /**
+     * @brief Stores the fitness of an individual, evicting another one if the shard is full.
+     *
+     * @param vector_size The size of the individual.
+     * @param vector The individual.
+     * @param fitness The fitness to store.
+     */
+    void insert(int vector_size, const int *vector, double fitness);
+
+    /**
+     * @brief Sums the lookup counts of all shards.
+     *
+     * @return The lookup counts since the cache was created.
+     */
+    Statistics statistics() const;
+
+    /**
+     * @brief Counts the cached individuals.
+     *
+     * @return The number of cached individuals.
+     */
+    int size() const;
+
+    /**
+     * @brief Hashes an individual.
+     *
+     * @param vector_size The size of the individual.
+     * @param vector The individual.
+     * @return A 64-bit hash of every gene and its position.
+     */
+    static std::uint64_t hash(int vector_size, const int *vector);
+
+private:
+    /**
+     * @struct Slot
+     * @brief One cached individual.
+     */
+    struct Slot {
+        std::uint64_t key_hash = 0;  ///< Hash of the individual.
+        std::vector<int> key;        ///< The individual, compared on every hit.
+        double fitness = 0.0;        ///< Cached fitness.
+        bool referenced = false;     ///< Set on a hit, cleared by the clock hand.
+    };
+
+    /**
+     * @struct Shard
+     * @brief Independently locked part of the cache.
+     */
+    struct Shard {
+        mutable std::mutex mutex;                     ///< Guards every member of the shard.
+        std::vector<Slot> slots;                      ///< Fixed number of slots.
+        std::unordered_map<std::uint64_t, int> index; ///< Hash of each cached individual to its slot.
+        int hand = 0;                                 ///< Clock hand for eviction.
+        int used = 0;                                 ///< Number of filled slots.
+        long long hits = 0;                           ///< Lookups that found the individual.
+        long long misses = 0;                         ///< Lookups that did not.
+    };
+
+    std::vector<Shard> shards;  ///< The shards, selected by the upper bits of the hash.
+};
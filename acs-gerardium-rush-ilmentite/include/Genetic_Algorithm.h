@@ -8,8 +8,11 @@
 #pragma once
 
 #include <vector>
+#include <random>
 #include <functional>  // Include this for std::function
 
+class Population_Buffer;
+
 /**
  * @struct Algorithm_Parameters
  * @brief Parameters for the genetic algorithm.
@@ -20,6 +23,9 @@ struct Algorithm_Parameters {
     double mutation_rate;   ///< Population mutation rate.
     double elitism_rate;    ///< Population elitism rate.
     double initial_pop;     ///< Initial population size.
+    int fitness_cache_capacity = 1 << 16;  ///< Individuals remembered by the fitness cache, 0 to disable it.
+    std::function<void(int)> generation_callback = nullptr;  ///< Called with the generation number once its fitness is evaluated, if set.
+    std::function<bool(int, int*, std::mt19937&)> generator = nullptr;  ///< Builds a valid individual, if set, instead of sampling and rejecting random ones.
     // other parameters for your algorithm
 };
 
@@ -40,42 +46,126 @@ bool all_true(int vector_size, int *vector);
 
 /**
  * @brief Performs a genetic algorithm optimization.
+ *
+ * Fitness values are memoized in a Fitness_Cache, so individuals seen in recent generations
+ * (elites and repeated offspring) are neither validated nor evaluated again. The cache hit
+ * rate of each generation is shown next to the progress bar.
  * 
  * @param population The population of solutions.
- * @param func The objective function.
+ * @param func The objective function; any callable such as a Circuit_Evaluator may be passed.
  * @param validity The validity function.
  * @param parameters The parameters for the genetic algorithm.
  * @return The best performance value found.
  */
 double genetic_algorithm(std::vector<std::vector<int>> &population, 
-                         double (&func)(int, int *),
+                         std::function<double(int, int *)> func,
                          std::function<bool(int, int *)> validity,
                          const Algorithm_Parameters &parameters);
 
+/**
+ * @brief Performs a genetic algorithm optimization, passing the elite cutoff to the objective.
+ *
+ * Works like genetic_algorithm, but from the second generation on the objective also receives
+ * the fitness of the weakest elite of the previous generation. An individual that cannot beat it
+ * will not become an elite, so the objective may stop evaluating it early and return any value
+ * below the cutoff (Evaluate_Circuit_Bounded does this).
+ * 
+ * @param population The population of solutions.
+ * @param func The objective function, taking the vector size, the vector and the elite cutoff.
+ * @param validity The validity function.
+ * @param parameters The parameters for the genetic algorithm.
+ * @return The best performance value found.
+ */
+double genetic_algorithm_bounded(std::vector<std::vector<int>> &population,
+                                 std::function<double(int, int *, double)> func,
+                                 std::function<bool(int, int *)> validity,
+                                 const Algorithm_Parameters &parameters);
+
 /**
  * @brief Optimizes a vector using the genetic algorithm.
  * 
  * @param vector_size Size of the vector.
  * @param vector Pointer to the vector.
- * @param func The objective function.
+ * @param func The objective function; any callable such as a Circuit_Evaluator may be passed.
  * @param validity The validity function.
  * @param parameters The parameters for the genetic algorithm.
  * @return The index of the best solution found.
  */
 int optimize(int vector_size, int *vector,
-             double (&func)(int, int *),
+             std::function<double(int, int *)> func,
              std::function<bool(int, int *)> validity,
              struct Algorithm_Parameters parameters = DEFAULT_ALGORITHM_PARAMETERS);
 
+/**
+ * @brief Optimizes a vector using genetic_algorithm_bounded.
+ * 
+ * @param vector_size Size of the vector.
+ * @param vector Pointer to the vector.
+ * @param func The objective function, taking the vector size, the vector and the elite cutoff.
+ * @param validity The validity function.
+ * @param parameters The parameters for the genetic algorithm.
+ * @return The index of the best solution found.
+ */
+int optimize_bounded(int vector_size, int *vector,
+                     std::function<double(int, int *, double)> func,
+                     std::function<bool(int, int *)> validity,
+                     struct Algorithm_Parameters parameters = DEFAULT_ALGORITHM_PARAMETERS);
+
 double find_max_double(const double *array, int size);
 
-std::vector<std::vector<int>> initialize_population(int population_size, int vector_size, const int* initial_vector, std::function<bool(int, int*)> validity, double elitism_rate);
+/**
+ * @brief Creates the first population from an initial vector.
+ *
+ * Threads fill the slots after the initial vector in parallel, taking them from an atomic
+ * counter, so the validity function and the generator must be safe to call concurrently. With a
+ * generator, each individual is built valid by it without retries; Random_Valid_Circuit is such
+ * a generator. Without one, or if it cannot build an individual of this size, random vectors are
+ * drawn until the validity function accepts them, so every individual after the initial vector
+ * is valid. Few random vectors are valid circuits, so without a generator this takes long for
+ * large circuits.
+ *
+ * @param population_size The size of the population.
+ * @param vector_size The size of each individual.
+ * @param initial_vector The first individual.
+ * @param validity The validity function.
+ * @param elitism_rate The rate of elitism.
+ * @param generator Builds a valid individual with the given random generator, or returns false.
+ * @return The population.
+ */
+std::vector<std::vector<int>> initialize_population(int population_size, int vector_size, const int* initial_vector, std::function<bool(int, int*)> validity, double elitism_rate,
+                                                    std::function<bool(int, int*, std::mt19937&)> generator = nullptr);
 
 void NonUniform_Mutation(std::vector<int>& individual, double mutation_rate, int max_value, int currentGeneration, int maxGenerations);
 
+void NonUniform_Mutation(int* individual, int vector_size, double mutation_rate, int max_value, int currentGeneration, int maxGenerations);
+
 void mutate_vector(std::vector<int>& vector, double mutation_rate, int max_unit);
 
+void mutate_vector(int* vector, int vector_size, double mutation_rate, int max_unit);
+
 void crossover(std::vector<int>& parent1, std::vector<int>& parent2, double crossover_rate, int max_value);
 
+void crossover(int* parent1, int* parent2, int vector_size, double crossover_rate, int max_value);
+
 int select_index(const std::vector<double>& cumulative_fitness);
 
+/**
+ * @brief Breeds the next generation of a population buffer from its current one.
+ *
+ * The first elitism_count individuals of ranking are copied unchanged into the first slots of
+ * the next generation, and every other slot gets a child bred by selection, crossover and
+ * mutation, with genes from 0 to number_of_units - 1. Pairs of children are bred in parallel.
+ *
+ * @param buffer The population; its current generation is read and its next generation filled.
+ * @param ranking The indices of the current generation, best first.
+ * @param elitism_count The number of elites carried over.
+ * @param cumulative_fitness The cumulative fitness of the current generation, for selection.
+ * @param parameters The crossover and non-uniform mutation rates and the number of iterations.
+ * @param mutation_rate The rate of the uniform mutation.
+ * @param generation The current generation number.
+ * @param number_of_units One more than the largest value a gene may take.
+ */
+void breed_generation(Population_Buffer& buffer, const std::vector<int>& ranking, int elitism_count,
+                      const std::vector<double>& cumulative_fitness, const Algorithm_Parameters& parameters,
+                      double mutation_rate, int generation, int number_of_units);
+
@@ -0,0 +1,111 @@
+/**
+ * @file Population_Buffer.h
+ * @brief Header for the flat population storage of the genetic algorithm.
+ *
+ * Storing the population as a vector of vectors puts every individual in its own allocation and
+ * forces a new outer vector, and a copy of every child, each generation. A Population_Buffer
+ * keeps the current and the next generation in one aligned block of genes instead, and swaps
+ * the two by pointer once the next generation is bred.
+ */
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+/**
+ * @class Population_Buffer
+ * @brief Two generations of equally sized individuals in one contiguous, aligned block.
+ *
+ * Individual i of a generation starts at i * stride() genes from the start of that generation.
+ * The stride rounds the vector size up to a whole number of cache lines, so every individual
+ * starts on a cache line and threads writing neighbouring individuals do not share one.
+ */
+class Population_Buffer
+{
+public:
+    static constexpr int alignment = 64;  ///< Alignment of every individual, in bytes.
+
+    /**
+     * @brief Creates a buffer for two generations, with every gene zero.
+     *
+     * @param population_size The number of individuals in a generation.
+     * @param vector_size The number of genes of an individual.
+     */
+    Population_Buffer(int population_size, int vector_size);
+
+    /**
+     * @brief Creates a buffer whose current generation is a copy of a population.
+     *
+     * @param population The population; every individual has the size of the first one.
+     */
+    explicit Population_Buffer(const std::vector<std::vector<int>> &population);
+
+    Population_Buffer(const Population_Buffer &) = delete;
+    Population_Buffer &operator=(const Population_Buffer &) = delete;
+
+    /**
+     * @brief Counts the individuals of a generation.
+     *
+     * @return The population size.
+     */
+    int size() const { return population_size; }
+
+    /**
+     * @brief Counts the genes of an individual.
+     *
+     * @return The vector size.
+     */
+    int vector_size() const { return genes; }
+
+    /**
+     * @brief Gives the distance between neighbouring individuals.
+     *
+     * @return The number of ints from one individual to the next, at least vector_size().
+     */
+    int stride() const { return row; }
+
+    /**
+     * @brief Gives an individual of the current generation.
+     *
+     * @param index The index of the individual.
+     * @return Its first gene.
+     */
+    int *individual(int index) { return current + static_cast<long>(index) * row; }
+
+    /**
+     * @brief Gives an individual of the current generation.
+     *
+     * @param index The index of the individual.
+     * @return Its first gene.
+     */
+    const int *individual(int index) const { return current + static_cast<long>(index) * row; }
+
+    /**
+     * @brief Gives a slot of the next generation.
+     *
+     * @param index The index of the slot.
+     * @return Its first gene.
+     */
+    int *next(int index) { return following + static_cast<long>(index) * row; }
+
+    /**
+     * @brief Makes the next generation the current one; the old one becomes the next to fill.
+     */
+    void swap() { std::swap(current, following); }
+
+    /**
+     * @brief Copies the current generation into a vector of vectors.
+     *
+     * @param population Receives the individuals, resized to fit.
+     */
+    void store(std::vector<std::vector<int>> &population) const;
+
+private:
+    int population_size;        ///< Individuals in a generation.
+    int genes;                  ///< Genes of an individual.
+    int row;                    ///< Ints from one individual to the next.
+    std::vector<int> storage;   ///< Both generations, with room to align the first individual.
+    int *current;               ///< First individual of the current generation.
+    int *following;             ///< First slot of the next generation.
+};
@@ -10,6 +10,7 @@ OUTPUT_DIR = "./output"
 POST_DOC_DIR = "./post-proc"
 VECTOR_FILE = "vector.dat"
 PERFORMANCE_FILE = "performance.dat"
+CONVERGENCE_FILE = "convergence.csv"
 LOG_INFO = logging.CRITICAL
 
 # Configure logging
@@ -488,6 +489,68 @@ def display_image(file: str) -> None:
         logging.error(f"An error occurred while displaying the image: {e}")
 
 
+def plot_convergence(convergence_file: str) -> str:
+    """
+    Plots the simulation counters written by the optimiser for every generation:
+    the mean number of sweeps, the share of circuits that did not converge, the
+    time per simulation and, when residuals were sampled, the mean residual after
+    sweep 1, 2, 4, ...
+
+    Returns:
+    str: The file path of the saved plot, or an empty string on failure.
+    """
+    logging.info(f"Plotting convergence statistics from {convergence_file}")
+    try:
+        statistics = pd.read_csv(convergence_file)
+        statistics = statistics[statistics["evaluations"] > 0]
+        if statistics.empty:
+            logging.warning("No simulations recorded in the statistics file")
+            return ""
+
+        fig, axes = plt.subplots(2, 2, figsize=(12, 8))
+        axes[0, 0].plot(statistics["period"], statistics["mean_sweeps"])
+        axes[0, 0].set_xlabel("Generation")
+        axes[0, 0].set_ylabel("Mean sweeps per simulation")
+
+        not_converged = statistics["not_converged"] / statistics["evaluations"]
+        axes[0, 1].plot(statistics["period"], 100 * not_converged)
+        axes[0, 1].set_xlabel("Generation")
+        axes[0, 1].set_ylabel("Not converged (%)")
+
+        axes[1, 0].plot(statistics["period"], statistics["mean_microseconds"])
+        axes[1, 0].set_xlabel("Generation")
+        axes[1, 0].set_ylabel("Time per simulation (us)")
+
+        # Sweep histogram over the whole run, next to the residual curve
+        histogram = statistics.filter(regex="^sweeps_").sum()
+        residuals = statistics.filter(like="residual_after_")
+        if residuals.notna().any().any():
+            sweeps = [int(c.split("_")[-1]) for c in residuals.columns]
+            weights = statistics["evaluations"]
+            curve = (residuals.mul(weights, axis=0).sum()
+                     / residuals.notna().mul(weights, axis=0).sum())
+            axes[1, 1].loglog(sweeps, curve.values, marker="o")
+            axes[1, 1].set_xlabel("Sweep")
+            axes[1, 1].set_ylabel("Mean residual")
+        else:
+            labels = [c.replace("sweeps_", "") for c in histogram.index]
+            axes[1, 1].bar(labels, histogram.values)
+            axes[1, 1].set_xlabel("Sweeps")
+            axes[1, 1].set_ylabel("Simulations")
+            axes[1, 1].tick_params(axis="x", rotation=45)
+
+        fig.tight_layout()
+        file_path = f"{POST_DOC_DIR}/convergence.png"
+        fig.savefig(file_path)
+        plt.close(fig)
+        return file_path
+    except FileNotFoundError as e:
+        logging.error(f"File not found: {e}")
+    except Exception as e:
+        logging.error(f"An error occurred while plotting the statistics: {e}")
+    return ""
+
+
 def main():
     """
     Main function to orchestrate reading data, creating diagram, annotating image, and displaying image.
@@ -512,6 +575,10 @@ def main():
                                             performance_values, headers=headers) # noqa
             if annotated_file:
                 display_image(annotated_file)
+    # Plot where the simulation time went, if the optimiser recorded it
+    convergence_file = os.path.join(OUTPUT_DIR, CONVERGENCE_FILE)
+    if os.path.exists(convergence_file):
+        plot_convergence(convergence_file)
 
 
 if __name__ == "__main__":
@@ -3,23 +3,287 @@
 #include <stdio.h>
 #include <CUnit.h>
 #include <CCircuit.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <mutex>
+#include <numeric>
 
 using namespace std;
 
+/**
+ * @brief Spread a set of units along the streams.
+ * 
+ * The units reached are bits of 64-bit words, so the marks of 64 units share a word and are
+ * counted with one popcount each. Units newly reached wait on an explicit stack, which can never
+ * hold more than all the units, so every unit is followed once and deep circuits cannot overflow
+ * the call stack.
+ * 
+ * @param num_units The number of units.
+ * @param reached The units to start from on entry; every unit reached on return.
+ * @param pending Scratch stack of units to follow.
+ * @param neighbours Called as neighbours(unit, mark) to pass every unit one step on from unit to mark.
+ * @return The number of units reached, including the starting ones.
+ */
+template <typename Neighbours>
+static int spread(int num_units, std::vector<std::uint64_t> &reached, std::vector<int> &pending,
+                  Neighbours neighbours) {
+    std::uint64_t *bits = reached.data();
+    pending.resize(num_units);
+    int *stack = pending.data();
+    int top = 0;
+    for (int word = 0; word < (num_units + 63) / 64; ++word) {
+        for (std::uint64_t seeds = bits[word]; seeds; seeds &= seeds - 1) {
+            stack[top++] = 64 * word + __builtin_ctzll(seeds);
+        }
+    }
+    auto mark = [&](int unit) {
+        std::uint64_t bit = std::uint64_t(1) << (unit & 63);
+        if (!(bits[unit >> 6] & bit)) {
+            bits[unit >> 6] |= bit;
+            stack[top++] = unit;
+        }
+    };
+    while (top > 0) {
+        neighbours(stack[--top], mark);
+    }
+    int count = 0;
+    for (std::uint64_t word : reached) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+
+/**
+ * @brief Name a validity code.
+ * 
+ * @param code The code.
+ * @return The name of the code, as written in the enumeration.
+ */
+const char *Validity_Code_Name(Validity_Code code) {
+    switch (code) {
+    case Validity_Code::valid: return "valid";
+    case Validity_Code::missing_value: return "missing_value";
+    case Validity_Code::unreachable_unit: return "unreachable_unit";
+    case Validity_Code::misrouted_outlet: return "misrouted_outlet";
+    case Validity_Code::self_recycle: return "self_recycle";
+    case Validity_Code::same_destination: return "same_destination";
+    case Validity_Code::missing_stream: return "missing_stream";
+    case Validity_Code::value_too_large: return "value_too_large";
+    case Validity_Code::tails_to_concentrate: return "tails_to_concentrate";
+    case Validity_Code::bad_feed: return "bad_feed";
+    }
+    return "unknown";
+}
+
+namespace {
+    /**
+     * @brief Every thread's validity counters, and the sum of those of threads that exited.
+     */
+    struct Validity_Registry {
+        std::mutex mutex;
+        std::vector<Validity_Statistics *> threads;
+        Validity_Statistics retired;
+    };
+
+    Validity_Registry &validity_registry() {
+        static Validity_Registry registry;
+        return registry;
+    }
+
+    /**
+     * @brief Counters of one thread, registered for as long as the thread runs.
+     */
+    struct Thread_Validity_Statistics {
+        Validity_Statistics statistics;
+
+        Thread_Validity_Statistics() {
+            Validity_Registry &registry = validity_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.push_back(&statistics);
+        }
+
+        ~Thread_Validity_Statistics() {
+            Validity_Registry &registry = validity_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.retired.merge(statistics);
+            registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &statistics));
+        }
+    };
+}
+
+/**
+ * @brief Get the validity counters of the calling thread.
+ * 
+ * @return The counters of the calling thread.
+ */
+Validity_Statistics &Local_Validity_Statistics() {
+    static thread_local Thread_Validity_Statistics local;
+    return local.statistics;
+}
+
+/**
+ * @brief Sum the validity counters of all threads.
+ * 
+ * @param reset Whether to clear the counters afterwards.
+ * @return The counters of all threads, including threads that have exited.
+ */
+Validity_Statistics Collect_Validity_Statistics(bool reset) {
+    Validity_Registry &registry = validity_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    Validity_Statistics total = registry.retired;
+    for (Validity_Statistics *statistics : registry.threads) {
+        total.merge(*statistics);
+    }
+    if (reset) {
+        registry.retired = Validity_Statistics();
+        for (Validity_Statistics *statistics : registry.threads) {
+            *statistics = Validity_Statistics();
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief Look for the faults a circuit can show in its own streams, in one scan of the vector.
+ * 
+ * The faults of all units are or-ed together without branches, comparing as unsigned so that one
+ * test catches negative values and values that are too large.
+ * 
+ * @param vector_size The size of the input vector.
+ * @param circuit_vector The input vector representing the circuit configuration.
+ * @return Validity_Code::valid, or the fault found: bad_feed, self_recycle or misrouted_outlet.
+ */
+Validity_Code Structural_Filter(int vector_size, const int *circuit_vector) {
+    if (vector_size < 4 || (vector_size - 1) % 3 != 0) {
+        return Validity_Code::valid;
+    }
+    int num_units = vector_size / 3;
+    unsigned units = num_units;
+    const int *streams = circuit_vector + 1;
+    int self_recycle = 0, misrouted = 0;
+    for (int i = 0; i < num_units; ++i) {
+        int conc = streams[3 * i], inter = streams[3 * i + 1], tails = streams[3 * i + 2];
+        self_recycle |= (conc == i) | (inter == i) | (tails == i);
+        misrouted |= (unsigned(conc) > units) | (unsigned(inter) >= units) |
+                     ((unsigned(tails) >= units) & (tails != num_units + 1));
+    }
+    if (unsigned(circuit_vector[0]) >= units) {
+        return Validity_Code::bad_feed;
+    }
+    if (self_recycle) {
+        return Validity_Code::self_recycle;
+    }
+    if (misrouted) {
+        return Validity_Code::misrouted_outlet;
+    }
+    return Validity_Code::valid;
+}
+
+/**
+ * @brief Count a check the structural pre-filter rejected.
+ * 
+ * @param statistics The counters to record in.
+ * @param fault The fault the pre-filter found.
+ */
+static void count_rejection(Validity_Statistics &statistics, Validity_Code fault) {
+    if (fault == Validity_Code::bad_feed) {
+        statistics.bad_feed++;
+    } else if (fault == Validity_Code::self_recycle) {
+        statistics.self_recycle++;
+    } else {
+        statistics.misrouted++;
+    }
+}
+
+/**
+ * @brief Check the validity of the circuit, timing the pre-filter and the full analysis.
+ * 
+ * The full analysis also runs when the pre-filter rejects the circuit, to measure what the
+ * pre-filter saved.
+ * 
+ * @param vector_size The size of the input vector.
+ * @param circuit_vector The input vector representing the circuit configuration.
+ * @param statistics The counters to record in.
+ * @return true if the circuit is valid, false otherwise.
+ */
+static bool timed_check(int vector_size, int *circuit_vector, Validity_Statistics &statistics) {
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    Validity_Code fault = Structural_Filter(vector_size, circuit_vector);
+    clock::time_point filtered = clock::now();
+    bool valid = Analyse_Validity(vector_size, circuit_vector) == Validity_Code::valid;
+    clock::time_point analysed = clock::now();
+
+    statistics.timed++;
+    statistics.filter_seconds += std::chrono::duration<double>(filtered - start).count();
+    if (fault != Validity_Code::valid) {
+        statistics.timed_rejections++;
+        statistics.avoided_seconds += std::chrono::duration<double>(analysed - filtered).count();
+        count_rejection(statistics, fault);
+        return false;
+    }
+    statistics.valid += valid;
+    return valid;
+}
+
 /**
  * @brief Check the validity of the circuit based on given criteria.
  * 
- * This function creates an instance of the Circuit class and uses it to 
- * validate the given circuit configuration.
+ * Circuits the structural pre-filter rejects never reach the full analysis. Every check is
+ * counted, and one in Validity_Statistics::sample_interval is timed.
  * 
  * @param vector_size The size of the input vector.
  * @param circuit_vector The input vector representing the circuit configuration.
  * @return true if the circuit is valid, false otherwise.
  */
 bool Check_Validity(int vector_size, int *circuit_vector){
-    Circuit circuitInstance(1);
-    return circuitInstance.Check_Validity(vector_size, circuit_vector);
+    Validity_Statistics &statistics = Local_Validity_Statistics();
+    if (statistics.checks++ % Validity_Statistics::sample_interval == 0) {
+        return timed_check(vector_size, circuit_vector, statistics);
+    }
+    Validity_Code fault = Structural_Filter(vector_size, circuit_vector);
+    if (fault != Validity_Code::valid) {
+        count_rejection(statistics, fault);
+        return false;
+    }
+    bool valid = Analyse_Validity(vector_size, circuit_vector) == Validity_Code::valid;
+    statistics.valid += valid;
+    return valid;
+}
+
+/**
+ * @brief Check the validity of the circuit and tell which rule it breaks.
+ * 
+ * This function analyses the given circuit configuration with a thread-local instance of the
+ * Circuit class. All scratch tables live in that instance, so threads never share them, and they
+ * are reused, so only the first call of a thread (or the first one with a larger circuit)
+ * allocates.
+ * 
+ * @param vector_size The size of the input vector.
+ * @param circuit_vector The input vector representing the circuit configuration.
+ * @return Validity_Code::valid, or the first rule the circuit breaks.
+ */
+Validity_Code Analyse_Validity(int vector_size, int *circuit_vector){
+    static thread_local Circuit circuitInstance(1);
+    return circuitInstance.analyse(vector_size, circuit_vector);
+}
+
+/**
+ * @brief Build a random circuit that is valid by construction.
+ * 
+ * The circuit is built with a thread-local instance of the Circuit class, whose scratch buffers
+ * are reused.
+ * 
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector Receives the circuit.
+ * @param generator The source of randomness.
+ * @return true if a circuit was built, false if the size allows no valid circuit.
+ */
+bool Random_Valid_Circuit(int vector_size, int *circuit_vector, std::mt19937 &generator) {
+    static thread_local Circuit circuitInstance(1);
+    return circuitInstance.generate(vector_size, circuit_vector, generator);
 }
 
 /**
@@ -40,111 +304,376 @@ Circuit::Circuit(int num_units) {
  * @return true if the circuit is valid, false otherwise.
  */
 bool Circuit::Check_Validity(int vector_size, int *circuit_vector) {
-    // Calculate the size of the vector in terms of number of elements.
-    int unit_size = 0;
+    return this->analyse(vector_size, circuit_vector) == Validity_Code::valid;
+}
 
-    // Determine the number of units and resize the units vector accordingly.
-    if ((vector_size - 1) % 3 == 0) {
-        this->units.resize(vector_size / 3);
-        unit_size = vector_size / 3;
-    } else {
-        this->units.resize(vector_size / 3 + 1);
-        unit_size = vector_size / 3 + 1;
+/**
+ * @brief Check the validity of the circuit and tell which rule it breaks.
+ * 
+ * Applies the same rules as the separate checks, in the same order, without building the units.
+ * One pass over the vector records which values appear; one pass over the units checks the rules
+ * that only look at one unit's own streams and notes the units feeding the concentrate outlet; a
+ * traversal over a bitset marks the units reachable from unit 0; and a last pass over the streams
+ * counts those entering the noted units, to compare their tailings with all the streams entering
+ * them. Everything is linear in the size of the vector, and each step returns as soon as a rule
+ * checked before the next step is broken, so most invalid vectors stop early.
+ * 
+ * A vector whose size is not 3 * units + 1 is read like the separate checks read it: the last
+ * unit gets the streams that are there, and the missing ones count as -1.
+ * 
+ * @param vector_size The size of the input vector.
+ * @param circuit_vector The input vector representing the circuit configuration.
+ * @return Validity_Code::valid, or the first rule the circuit breaks.
+ */
+Validity_Code Circuit::analyse(int vector_size, int *circuit_vector) {
+    if (vector_size < 2) {
+        return Validity_Code::missing_stream;
     }
-
-    // Assign the values from the circuit_vector to the respective units.
-    for (int i = 0; i < unit_size; ++i) {
-        this->units[i].conc_num = circuit_vector[3 * i + 1];
-        if (vector_size > 3 * i + 2)
-            this->units[i].inter_num = circuit_vector[3 * i + 2];
-        if (vector_size > 3 * i + 3)
-            this->units[i].tails_num = circuit_vector[3 * i + 3];
-        this->units[i].mark = false;
+    if ((vector_size - 1) % 3 != 0) {
+        // Give the last unit its missing streams as -1, then analyse the whole units.
+        this->padded.assign(circuit_vector, circuit_vector + vector_size);
+        this->padded.resize(3 * (vector_size / 3 + 1) + 1, -1);
+        return this->analyse(this->padded.size(), this->padded.data());
     }
+    int num_units = vector_size / 3;
+    const int *streams = circuit_vector + 1;
 
-    // Check if all required values are present in the circuit vector.
-    if (!this->check_values(vector_size, circuit_vector)) {
-        return false;
+    // Every value below the largest one must appear; that needs at least as many entries as values.
+    int max = 0;
+    for (int i = 0; i < vector_size; ++i) {
+        max = circuit_vector[i] > max ? circuit_vector[i] : max;
     }
-
-    // Check if all units are reachable from the feed.
-    if (!this->is_reachable()) {
-        return false;
+    if (max > vector_size) {
+        return Validity_Code::missing_value;
     }
-
-    // Check if the concentrate and tailing streams are valid.
-    if (!this->concentrate_tailing_check()) {
-        return false;
+    this->value_seen.assign(max + 1, 0);
+    char *seen = this->value_seen.data();
+    for (int i = 0; i < vector_size; ++i) {
+        if (circuit_vector[i] >= 0) {
+            seen[circuit_vector[i]] = 1;
+        }
+    }
+    bool values_present = true;
+    for (int value = 0; value < max; ++value) {
+        values_present &= seen[value] != 0;
+    }
+    if (!values_present) {
+        return Validity_Code::missing_value;
     }
 
-    // Check for self-recycles.
-    if (!this->self_recycle_check()) {
-        return false;
+    // The rules on a unit's own streams, combined without branches into one flag; which rule is
+    // broken is only worked out if one is. Units feeding the concentrate outlet are noted for the
+    // tailings rule.
+    int words = (num_units + 63) / 64;
+    this->concentrate_bits.assign(words, 0);
+    std::uint64_t *feeds_concentrate = this->concentrate_bits.data();
+    bool broken = false, has_concentrate = false, has_tailings = false;
+    for (int i = 0; i < num_units; ++i) {
+        int conc = streams[3 * i], inter = streams[3 * i + 1], tails = streams[3 * i + 2];
+        broken |= (inter == num_units) | (tails == num_units) | (conc == num_units + 1) | (inter == num_units + 1) |
+                  (conc == i) | (inter == i) | (tails == i) | ((conc == inter) & (inter == tails)) |
+                  (conc < 0) | (inter < 0) | (tails < 0) |
+                  (conc > num_units) | (inter > num_units - 1) | (tails > num_units + 1);
+        has_concentrate |= conc == num_units;
+        has_tailings |= tails == num_units + 1;
+        feeds_concentrate[i >> 6] |= std::uint64_t(conc == num_units) << (i & 63);
     }
 
-    // Check if all product streams of a unit do not point to the same unit.
-    if (!this->same_unit_dest_check()) {
-        return false;
+    // Follow the streams from unit 0; any destination that is not a unit leaves the circuit.
+    this->reached_bits.assign(words, 0);
+    this->reached_bits[0] = 1;
+    int num_reached = spread(num_units, this->reached_bits, this->pending,
+                             [&](int unit, auto &mark) {
+                                 for (int k = 0; k < 3; ++k) {
+                                     int next = streams[3 * unit + k];
+                                     if (next >= 0 && next < num_units) {
+                                         mark(next);
+                                     }
+                                 }
+                             });
+    if (num_reached < num_units) {
+        return Validity_Code::unreachable_unit;
+    }
+    if (!has_concentrate || !has_tailings) {
+        return Validity_Code::misrouted_outlet;
+    }
+    if (broken) {
+        return unit_rule_broken(num_units, streams);
     }
 
-    // Check if all units have a path to all outlets.
-    if (!this->end_of_vector_check()) {
-        return false;
+    // At most half of the streams entering a unit that feeds the concentrate outlet may be tailings.
+    // Only those units are counted.
+    this->incoming.assign(num_units, 0);
+    this->incoming_tails.assign(num_units, 0);
+    for (int i = 0; i < 3 * num_units; ++i) {
+        int destination = streams[i];
+        if (destination >= 0 && destination < num_units && ((feeds_concentrate[destination >> 6] >> (destination & 63)) & 1)) {
+            this->incoming[destination]++;
+            this->incoming_tails[destination] += i % 3 == 2;
+        }
+    }
+    for (int i = 0; i < num_units; ++i) {
+        if (((feeds_concentrate[i >> 6] >> (i & 63)) & 1) && this->incoming_tails[i] > this->incoming[i] * 0.5) {
+            return Validity_Code::tails_to_concentrate;
+        }
     }
 
-    // Check if the maximum value constraints are met.
-    if (!this->max_value_check(vector_size, circuit_vector)) {
-        return false;
+    if (circuit_vector[0] < 0 || circuit_vector[0] >= num_units) {
+        return Validity_Code::bad_feed;
     }
+    return Validity_Code::valid;
+}
 
-    // Check if the tailings percentage to the concentrate outlet is greater than 50%.
-    if (!this->tail_percentage_to_concentrate_outlet_check()) {
-        return false;
+/**
+ * @brief Tell which of the rules on a unit's own streams a circuit breaks first.
+ * 
+ * The rules are checked one at a time over all units, in the order of the separate checks.
+ * 
+ * @param num_units The number of units.
+ * @param streams The streams of the units, three per unit.
+ * @return The first rule broken, or Validity_Code::valid if none is.
+ */
+Validity_Code Circuit::unit_rule_broken(int num_units, const int *streams) {
+    for (int i = 0; i < num_units; ++i) {
+        int conc = streams[3 * i], inter = streams[3 * i + 1], tails = streams[3 * i + 2];
+        if (inter == num_units || tails == num_units || conc == num_units + 1 || inter == num_units + 1) {
+            return Validity_Code::misrouted_outlet;
+        }
+    }
+    for (int i = 0; i < num_units; ++i) {
+        if (streams[3 * i] == i || streams[3 * i + 1] == i || streams[3 * i + 2] == i) {
+            return Validity_Code::self_recycle;
+        }
+    }
+    for (int i = 0; i < num_units; ++i) {
+        if (streams[3 * i] == streams[3 * i + 1] && streams[3 * i + 1] == streams[3 * i + 2]) {
+            return Validity_Code::same_destination;
+        }
+    }
+    for (int i = 0; i < 3 * num_units; ++i) {
+        if (streams[i] < 0) {
+            return Validity_Code::missing_stream;
+        }
+    }
+    for (int i = 0; i < num_units; ++i) {
+        if (streams[3 * i] > num_units || streams[3 * i + 1] > num_units - 1 || streams[3 * i + 2] > num_units + 1) {
+            return Validity_Code::value_too_large;
+        }
     }
+    return Validity_Code::valid;
+}
 
-    // Check if the feed value is within the valid range.
-    if (!this->check_feed_value(circuit_vector)) {
+/**
+ * @brief Build a random circuit that is valid by construction.
+ * 
+ * @param vector_size The size of the circuit vector, 3 * units + 1 with at least 2 units.
+ * @param circuit_vector Receives the circuit.
+ * @param generator The source of randomness.
+ * @return true if a circuit was built, false if the size allows no valid circuit.
+ */
+bool Circuit::generate(int vector_size, int *circuit_vector, std::mt19937 &generator) {
+    if (vector_size < 7 || (vector_size - 1) % 3 != 0) {
         return false;
     }
+    int num_units = vector_size / 3;
+    int *streams = circuit_vector + 1;
+    auto below = [&generator](int bound) {
+        return std::uniform_int_distribution<int>(0, bound - 1)(generator);
+    };
+    auto other_unit = [&below, num_units](int unit) {
+        int other = below(num_units - 1);
+        return other < unit ? other : other + 1;
+    };
+    std::bernoulli_distribution leaves(outlet_probability);
+
+    do {
+        // The units sending their concentrate out, at least one
+        this->sends_concentrate.assign(num_units, 0);
+        bool any = false;
+        for (int unit = 0; unit < num_units; ++unit) {
+            this->sends_concentrate[unit] = leaves(generator);
+            any = any || this->sends_concentrate[unit];
+        }
+        if (!any) {
+            this->sends_concentrate[below(num_units)] = 1;
+        }
+
+        // A spanning tree from unit 0. Each unit placed so far has at least one stream left that
+        // the next unit may take, so the search always ends.
+        std::fill(circuit_vector, circuit_vector + vector_size, -1);
+        this->tree_stream.assign(3 * num_units, 0);
+        this->order.resize(num_units);
+        std::iota(this->order.begin(), this->order.end(), 0);
+        std::shuffle(this->order.begin() + 1, this->order.end(), generator);
+        for (int k = 1; k < num_units; ++k) {
+            int child = this->order[k];
+            int parent, kind;
+            do {
+                parent = this->order[below(k)];
+                kind = below(3);
+            } while (streams[3 * parent + kind] != -1 || (kind == 0 && this->sends_concentrate[parent]) ||
+                     (kind == 2 && this->sends_concentrate[child]));
+            streams[3 * parent + kind] = child;
+            this->tree_stream[3 * parent + kind] = 1;
+        }
+
+        // The other streams
+        for (int unit = 0; unit < num_units; ++unit) {
+            int *unit_streams = streams + 3 * unit;
+            if (unit_streams[0] == -1) {
+                unit_streams[0] = this->sends_concentrate[unit] ? num_units : other_unit(unit);
+            }
+            if (unit_streams[1] == -1) {
+                unit_streams[1] = other_unit(unit);
+            }
+            if (unit_streams[2] == -1) {
+                int tails = leaves(generator) ? num_units + 1 : other_unit(unit);
+                unit_streams[2] = tails < num_units && this->sends_concentrate[tails] ? num_units + 1 : tails;
+            }
+        }
+
+        // Some tailings stream must leave; the tree, with one stream fewer than there are units,
+        // cannot hold every tailings stream
+        bool tailings_leave = false;
+        for (int unit = 0; unit < num_units; ++unit) {
+            tailings_leave = tailings_leave || streams[3 * unit + 2] == num_units + 1;
+        }
+        for (int start = below(num_units), k = 0; !tailings_leave; ++k) {
+            int unit = (start + k) % num_units;
+            if (!this->tree_stream[3 * unit + 2]) {
+                streams[3 * unit + 2] = num_units + 1;
+                tailings_leave = true;
+            }
+        }
 
+        // A unit with three identical streams keeps the concentrate and changes a stream that is
+        // not in the tree: the tailings leave, or the intermediate goes to a third unit
+        for (int unit = 0; unit < num_units; ++unit) {
+            int *unit_streams = streams + 3 * unit;
+            if (unit_streams[0] != unit_streams[1] || unit_streams[1] != unit_streams[2]) {
+                continue;
+            }
+            if (!this->tree_stream[3 * unit + 2]) {
+                unit_streams[2] = num_units + 1;
+            } else if (num_units > 2) {
+                do {
+                    unit_streams[1] = other_unit(unit);
+                } while (unit_streams[1] == unit_streams[0]);
+            }
+        }
+
+        // Unit 0 has to appear in the vector; the feed can always go there
+        circuit_vector[0] = below(num_units);
+        if (std::find(streams, streams + 3 * num_units, 0) == streams + 3 * num_units) {
+            circuit_vector[0] = 0;
+        }
+    } while (this->analyse(vector_size, circuit_vector) != Validity_Code::valid);
     return true;
 }
 
-// Variables to track if each outlet has been reached.
-bool conc_outlet_reached, inter_outlet_reached, tails_outlet_reached;
-
 /**
- * @brief Mark units as reachable starting from a specific unit.
+ * @brief Find which units have a path to each outlet.
  * 
- * @param unit_num The starting unit number.
+ * Builds the list of units sending a stream to each unit, then spreads backwards from the units
+ * with a stream into each outlet.
+ * 
+ * @param vector_size The size of the input vector, 3 * units + 1.
+ * @param circuit_vector The input vector representing the circuit configuration.
+ * @return true if every unit has a path to both outlets, false otherwise.
  */
-void Circuit::mark_units(int unit_num) {
-    // If the unit is already marked, return.
-    if (this->units[unit_num].mark)
-        return;
+bool Circuit::outlets_reachable(int vector_size, int *circuit_vector) {
+    int num_units = (vector_size - 1) / 3;
+    int num_words = (num_units + 63) / 64;
+    this->predecessor_start.assign(num_units + 1, 0);
+    for (int i = 1; i < vector_size; ++i) {
+        if (circuit_vector[i] >= 0 && circuit_vector[i] < num_units) {
+            this->predecessor_start[circuit_vector[i] + 1]++;
+        }
+    }
+    for (int unit = 0; unit < num_units; ++unit) {
+        this->predecessor_start[unit + 1] += this->predecessor_start[unit];
+    }
+    this->predecessors.resize(this->predecessor_start[num_units]);
+    this->incoming.assign(this->predecessor_start.begin(), this->predecessor_start.end() - 1);
+    this->concentrate_bits.assign(num_words, 0);
+    this->tailings_bits.assign(num_words, 0);
+    for (int i = 1; i < vector_size; ++i) {
+        int unit = (i - 1) / 3;
+        int destination = circuit_vector[i];
+        if (destination >= 0 && destination < num_units) {
+            this->predecessors[this->incoming[destination]++] = unit;
+        } else if (destination == num_units) {
+            this->concentrate_bits[unit >> 6] |= std::uint64_t(1) << (unit & 63);
+        } else if (destination == num_units + 1) {
+            this->tailings_bits[unit >> 6] |= std::uint64_t(1) << (unit & 63);
+        }
+    }
 
-    // Mark the current unit.
-    this->units[unit_num].mark = true;
+    auto senders = [&](int unit, auto &mark) {
+        for (int k = this->predecessor_start[unit]; k < this->predecessor_start[unit + 1]; ++k) {
+            mark(this->predecessors[k]);
+        }
+    };
+    int to_concentrate = spread(num_units, this->concentrate_bits, this->pending, senders);
+    int to_tailings = spread(num_units, this->tailings_bits, this->pending, senders);
+    return to_concentrate == num_units && to_tailings == num_units;
+}
 
-    // Recursively mark units reachable from conc_num.
-    if (this->units[unit_num].conc_num < this->units.size()) {
-        mark_units(this->units[unit_num].conc_num);
-    } else {
-        conc_outlet_reached = true;
-    }
+/**
+ * @brief Tell if a unit has a path to the concentrate outlet.
+ * 
+ * @param unit The unit, as of the last call to outlets_reachable.
+ * @return true if the unit reaches the concentrate outlet, false otherwise.
+ */
+bool Circuit::reaches_concentrate(int unit) const {
+    return (this->concentrate_bits[unit >> 6] >> (unit & 63)) & 1;
+}
 
-    // Recursively mark units reachable from inter_num.
-    if (this->units[unit_num].inter_num < this->units.size()) {
-        mark_units(this->units[unit_num].inter_num);
-    } else {
-        inter_outlet_reached = true;
-    }
+/**
+ * @brief Tell if a unit has a path to the tailings outlet.
+ * 
+ * @param unit The unit, as of the last call to outlets_reachable.
+ * @return true if the unit reaches the tailings outlet, false otherwise.
+ */
+bool Circuit::reaches_tailings(int unit) const {
+    return (this->tailings_bits[unit >> 6] >> (unit & 63)) & 1;
+}
 
-    // Recursively mark units reachable from tails_num.
-    if (this->units[unit_num].tails_num < this->units.size()) {
-        mark_units(this->units[unit_num].tails_num);
-    } else {
-        tails_outlet_reached = true;
+/**
+ * @brief Mark units as reachable starting from a specific unit.
+ * 
+ * Follows the streams with an explicit stack of units to visit rather than by recursion, so a
+ * long chain of units cannot overflow the call stack.
+ * 
+ * @param unit_num The starting unit number.
+ */
+void Circuit::mark_units(int unit_num) {
+    this->pending.assign(1, unit_num);
+    while (!this->pending.empty()) {
+        CUnit &unit = this->units[this->pending.back()];
+        this->pending.pop_back();
+
+        // If the unit is already marked, it has been followed.
+        if (unit.mark)
+            continue;
+        unit.mark = true;
+
+        // Visit the units the streams go to, and note the streams leaving the circuit.
+        if (static_cast<size_t>(unit.conc_num) < this->units.size()) {
+            this->pending.push_back(unit.conc_num);
+        } else {
+            conc_outlet_reached = true;
+        }
+        if (static_cast<size_t>(unit.inter_num) < this->units.size()) {
+            this->pending.push_back(unit.inter_num);
+        } else {
+            inter_outlet_reached = true;
+        }
+        if (static_cast<size_t>(unit.tails_num) < this->units.size()) {
+            this->pending.push_back(unit.tails_num);
+        } else {
+            tails_outlet_reached = true;
+        }
     }
 }
 
@@ -155,10 +684,11 @@ void Circuit::mark_units(int unit_num) {
  */
 bool Circuit::is_reachable() {
 
-    // Reset the mark status for all units.
+    // Reset the mark status for all units and the outlets reached.
     for (auto& unit : this->units) {
         unit.mark = false;
     }
+    conc_outlet_reached = inter_outlet_reached = tails_outlet_reached = false;
 
     // Mark units starting from the feed.
     mark_units(0);
@@ -179,19 +709,20 @@ bool Circuit::is_reachable() {
  * @return true if all units have a path to all outlets, false otherwise.
  */
 bool Circuit::end_of_vector_check() {
-    // Reset the mark status for all units.
+    // Reset the mark status for all units and the outlets reached.
     for (auto& unit : this->units) {
         unit.mark = false;
     }
+    conc_outlet_reached = inter_outlet_reached = tails_outlet_reached = false;
 
     // Mark units starting from the feed.
     mark_units(0);
 
     // Check if any unit has an invalid outlet path.
     for (auto& unit : this->units) {
-        if (unit.conc_num == -1 ||
-            unit.inter_num == -1 ||
-            unit.tails_num == -1) {
+        if (unit.conc_num < 0 ||
+            unit.inter_num < 0 ||
+            unit.tails_num < 0) {
             return false;
         }
     }
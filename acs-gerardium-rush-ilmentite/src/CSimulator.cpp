@@ -1,145 +1,1625 @@
 #include "CUnit.h"
 #include "CCircuit.h"
 #include "CSimulator.h"
+#include "CircuitSimulator.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <mutex>
 #include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Unit counts with a compile-time specialised simulator, set from CMake
+#ifndef CIRCUIT_FIXED_UNITS
+#define CIRCUIT_FIXED_UNITS 10, 42
+#endif
+
+/**
+ * @brief Simulates a circuit with the fixed-size simulator if it has NUnits units.
+ *
+ * @param num_units The number of units in the circuit.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @param parameters The solver settings.
+ * @param result Receives the result of the simulation.
+ * @return True if the circuit was simulated, false if it has a different number of units.
+ */
+template <int NUnits>
+static bool simulate_fixed_units(int num_units, int *circuit_vector, const Circuit_Parameters &parameters,
+                                 const Flow_State *initial_state, Flow_State *final_state, Evaluation_Result &result)
+{
+  if (num_units != NUnits)
+  {
+    return false;
+  }
+  static thread_local CircuitSimulator<NUnits> simulator;
+  result = simulator.simulate(circuit_vector, parameters, initial_state, final_state);
+  return true;
+}
+
+/**
+ * @brief Simulates a circuit with the first fixed-size simulator matching its number of units.
+ *
+ * @return True if one of the simulators matched, false otherwise.
+ */
+template <int... Units>
+static bool simulate_fixed(int num_units, int *circuit_vector, const Circuit_Parameters &parameters,
+                           const Flow_State *initial_state, Flow_State *final_state, Evaluation_Result &result)
+{
+  return (simulate_fixed_units<Units>(num_units, circuit_vector, parameters, initial_state, final_state, result) || ...);
+}
+
+/**
+ * @brief Evaluates the performance of a circuit based on a given vector.
+ *
+ * This function simulates the operation of a circuit and calculates its performance.
+ * The simulation runs in a thread-local simulator, so the buffers are reused between calls.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @return The performance value of the circuit.
+ */
+
+double Evaluate_Circuit(int vector_size, int *circuit_vector)
+{
+  return Simulate_Circuit(vector_size, circuit_vector).performance;
+}
+
+/**
+ * @brief Evaluates the performance of a circuit, giving up once it cannot reach a threshold.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @param threshold The performance worth simulating for.
+ * @return The performance value of the circuit, or a prediction below the threshold.
+ */
+double Evaluate_Circuit_Bounded(int vector_size, int *circuit_vector, double threshold)
+{
+  Circuit_Parameters parameters;
+  parameters.abort_below = threshold;
+  return Simulate_Circuit(vector_size, circuit_vector, parameters).performance;
+}
+
+/**
+ * @brief Simulates a circuit and returns its performance, recovery, grade and convergence.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @param parameters The solver settings.
+ * @param initial_state Flows to start from, or nullptr for a cold start.
+ * @param final_state Receives the flows of the last sweep if not nullptr.
+ * @return The result of the simulation.
+ */
+struct Evaluation_Result Simulate_Circuit(int vector_size, int *circuit_vector, const Circuit_Parameters &parameters,
+                                          const Flow_State *initial_state, Flow_State *final_state)
+{
+  auto start = std::chrono::steady_clock::now();
+  struct Evaluation_Result result;
+
+  // Plain sweeps of the campaign unit counts use the compile-time specialised simulators
+  bool simulated = false;
+  if (parameters.solver == Solver_Mode::jacobi && !parameters.parallel_units && parameters.recovery_table_error <= 0.0 &&
+      parameters.single_precision_until <= 0.0)
+  {
+    simulated = simulate_fixed<CIRCUIT_FIXED_UNITS>((vector_size - 1) / 3, circuit_vector, parameters, initial_state, final_state, result);
+  }
+  if (!simulated)
+  {
+    static thread_local SimulationWorkspace workspace;
+    result = workspace.simulate(vector_size, circuit_vector, parameters, initial_state, final_state);
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  Local_Simulation_Statistics().record(result, elapsed.count());
+  return result;
+}
+
+/**
+ * @brief Writes the performance, recovery, and grade of a circuit to a file.
+ *
+ * @param result The result of the simulation.
+ * @param filename The file to write to.
+ * @return true if the file was written, false otherwise.
+ */
+bool Write_Performance(const Evaluation_Result &result, const std::string &filename)
+{
+  std::ofstream outFile(filename);
+  if (!outFile.is_open())
+  {
+    return false;
+  }
+
+  outFile << result.performance << "\n";
+  outFile << result.recovery << "\n";
+  outFile << result.grade << "\n";
+
+  outFile.close();
+  return true;
+}
+
+namespace
+{
+  /**
+   * @brief Every thread's simulation counters, and the sum of those of threads that exited.
+   */
+  struct Statistics_Registry
+  {
+    std::mutex mutex;
+    std::vector<Simulation_Statistics *> threads;
+    Simulation_Statistics retired;
+  };
+
+  Statistics_Registry &statistics_registry()
+  {
+    static Statistics_Registry registry;
+    return registry;
+  }
+
+  /**
+   * @brief Counters of one thread, registered for as long as the thread runs.
+   */
+  struct Thread_Statistics
+  {
+    Simulation_Statistics statistics;
+
+    Thread_Statistics()
+    {
+      Statistics_Registry &registry = statistics_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.threads.push_back(&statistics);
+    }
+
+    ~Thread_Statistics()
+    {
+      Statistics_Registry &registry = statistics_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.retired.merge(statistics);
+      registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), &statistics));
+    }
+  };
+}
+
+/**
+ * @brief Gets the simulation counters of the calling thread.
+ *
+ * @return The counters of the calling thread.
+ */
+Simulation_Statistics &Local_Simulation_Statistics()
+{
+  static thread_local Thread_Statistics local;
+  return local.statistics;
+}
+
+/**
+ * @brief Sums the simulation counters of all threads.
+ *
+ * @param reset Whether to clear the counters afterwards.
+ * @return The counters of all threads, including threads that have exited.
+ */
+Simulation_Statistics Collect_Simulation_Statistics(bool reset)
+{
+  Statistics_Registry &registry = statistics_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  Simulation_Statistics total = registry.retired;
+  for (Simulation_Statistics *statistics : registry.threads)
+  {
+    total.merge(*statistics);
+  }
+  if (reset)
+  {
+    registry.retired = Simulation_Statistics();
+    for (Simulation_Statistics *statistics : registry.threads)
+    {
+      *statistics = Simulation_Statistics();
+    }
+  }
+  return total;
+}
+
+/**
+ * @brief Writes one CSV row of simulation counters per period.
+ *
+ * Besides the raw counts every row has the mean sweeps, the mean time per simulation and the
+ * geometric mean residual after each sampled sweep (empty where no simulation got that far).
+ *
+ * @param periods The counters of each period.
+ * @param filename The file to write to.
+ * @return True if the file could be written, false otherwise.
+ */
+bool Write_Simulation_Statistics(const std::vector<Simulation_Statistics> &periods, const std::string &filename)
+{
+  std::ofstream outFile(filename);
+  if (!outFile.is_open())
+  {
+    return false;
+  }
+
+  outFile << "period,evaluations,converged,not_converged,sweeps,mean_sweeps,max_sweeps,seconds,mean_microseconds,"
+          << "final_residual_not_converged";
+  for (int b = 0; b < Simulation_Statistics::num_buckets; b++)
+  {
+    int low = 1 << b;
+    if (b == Simulation_Statistics::num_buckets - 1)
+    {
+      outFile << ",sweeps_" << low << "_up";
+    }
+    else
+    {
+      outFile << ",sweeps_" << low << "_" << (2 * low - 1);
+    }
+  }
+  for (int b = 0; b < Simulation_Statistics::num_buckets; b++)
+  {
+    outFile << ",residual_after_" << (1 << b);
+  }
+  outFile << "\n";
+
+  for (size_t p = 0; p < periods.size(); p++)
+  {
+    const Simulation_Statistics &s = periods[p];
+    long long not_converged = s.evaluations - s.converged;
+    outFile << p << "," << s.evaluations << "," << s.converged << "," << not_converged << "," << s.sweeps << ","
+            << (s.evaluations > 0 ? double(s.sweeps) / s.evaluations : 0.0) << "," << s.max_sweeps << ","
+            << s.seconds << "," << (s.evaluations > 0 ? 1e6 * s.seconds / s.evaluations : 0.0) << ",";
+    if (not_converged > 0)
+    {
+      outFile << std::pow(10.0, s.log_final_residual / not_converged);
+    }
+    for (int b = 0; b < Simulation_Statistics::num_buckets; b++)
+    {
+      outFile << "," << s.sweep_histogram[b];
+    }
+    for (int b = 0; b < Simulation_Statistics::num_buckets; b++)
+    {
+      outFile << ",";
+      if (s.residual_samples[b] > 0)
+      {
+        outFile << std::pow(10.0, s.log_residual[b] / s.residual_samples[b]);
+      }
+    }
+    outFile << "\n";
+  }
+
+  outFile.close();
+  return true;
+}
+
+/**
+ * @brief Loads the unit connections and the initial flow rates into the buffers.
+ *
+ * The buffers are resized rather than rebuilt, so no allocation happens once they are large enough.
+ *
+ * @param circuit_vector The array representing the circuit configuration.
+ * @param n The number of units in the circuit.
+ * @param init_flow The initial flow rates.
+ * @param initial_state Flows to start from, or nullptr for a cold start.
+ */
+void SimulationWorkspace::load(int *circuit_vector, int n, const Initial_flow &init_flow, const Flow_State *initial_state)
+{
+  num_units = n;
+  conc_num.resize(n);
+  inter_num.resize(n);
+  tails_num.resize(n);
+  old_flow_G.resize(n);
+  old_flow_W.resize(n);
+  new_flow_G.resize(n);
+  new_flow_W.resize(n);
+
+  for (int i = 0; i < n; i++)
+  {
+    conc_num[i] = circuit_vector[3 * i + 1];
+    inter_num[i] = circuit_vector[3 * i + 2];
+    tails_num[i] = circuit_vector[3 * i + 3];
+    old_flow_G[i] = init_flow.init_Fg;
+    old_flow_W[i] = init_flow.init_Fw;
+    new_flow_G[i] = 0.0;
+    new_flow_W[i] = 0.0;
+  }
+  if (initial_state != nullptr && initial_state->matches(n))
+  {
+    for (int i = 0; i < n; i++)
+    {
+      old_flow_G[i] = Flow_State::starting_flow(initial_state->flow_G[i], init_flow.init_Fg);
+      old_flow_W[i] = Flow_State::starting_flow(initial_state->flow_W[i], init_flow.init_Fw);
+    }
+  }
+
+  build_incoming();
+}
+
+/**
+ * @brief Evaluates the performance of a circuit using the buffers of this workspace.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @return The performance value of the circuit.
+ */
+double SimulationWorkspace::evaluate(int vector_size, int *circuit_vector)
+{
+  return simulate(vector_size, circuit_vector).performance;
+}
+
+/**
+ * @brief Simulates a circuit using the buffers of this workspace.
+ *
+ * Judge if the circuit has converged (using the difference between the old and new flow rates),
+ * if not, set the performance to 90 * -750.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The array representing the circuit configuration.
+ * @param parameters The solver settings.
+ * @param initial_state Flows to start from, or nullptr for a cold start.
+ * @param final_state Receives the flows of the last sweep if not nullptr.
+ * @return The performance, recovery, grade and convergence information.
+ */
+struct Evaluation_Result SimulationWorkspace::simulate(int vector_size, int *circuit_vector, const Circuit_Parameters &parameters,
+                                                       const Flow_State *initial_state, Flow_State *final_state)
+{
+  const Initial_flow &init_flow = parameters.feed;
+  const Economic_parameters &eco = parameters.eco;
+
+  struct Evaluation_Result result;
+
+  // Calculate the number of units in the circuit
+  int length = (vector_size - 1) / 3;
+  load(circuit_vector, length, init_flow, initial_state);
+  if (!kernel.folds(parameters.constants))
+  {
+    kernel = Recovery_Kernel(parameters.constants);
+  }
+  if (kernel.table_error != parameters.recovery_table_error)
+  {
+    kernel.tabulate(parameters.recovery_table_error);
+  }
+  anderson_columns = 0;
+  anderson_next = 0;
+  anderson_has_previous = false;
+
+  // Splitting the units across threads only pays off when nobody else is using the cores
+  bool parallel = parameters.parallel_units;
+#ifdef _OPENMP
+  parallel = parallel && !omp_in_parallel();
+#endif
+
+  Simulation_Statistics &statistics = Local_Simulation_Statistics();
+  bool sample_residuals = Simulation_Statistics::sampling_residuals();
+  Abort_Monitor monitor(parameters, init_flow.init_Fw * eco.penalty);
+
+  bool in_place = parameters.solver == Solver_Mode::gauss_seidel;
+  if (in_place)
+  {
+    order_units(circuit_vector[0]);
+  }
+
+  // Plain sweeps may start in single precision; float cannot resolve the tolerance, so they
+  // switch to double once the residual is small
+  bool single = parameters.solver == Solver_Mode::jacobi && parameters.single_precision_until > 0.0;
+  if (single)
+  {
+    single_old_G.assign(old_flow_G.begin(), old_flow_G.end());
+    single_old_W.assign(old_flow_W.begin(), old_flow_W.end());
+    single_new_G.resize(length);
+    single_new_W.resize(length);
+    single_output_G.resize(3 * length);
+    single_output_W.resize(3 * length);
+  }
+
+  // Whether the flows of the last sweep were moved to the old buffers
+  bool last_in_old = false;
+  int i;
+  for (i = 0; i < parameters.max_iterations; i++)
+  {
+    double concentrate_gerardium = 0.0;
+    double concentrate_waste = 0.0;
+    double sweep_residual;
+    if (single)
+    {
+      sweep_residual = sweep_single(init_flow, circuit_vector[0], concentrate_gerardium, concentrate_waste, parallel);
+    }
+    else if (in_place)
+    {
+      sweep_residual = sweep_in_place(init_flow, circuit_vector[0], concentrate_gerardium, concentrate_waste);
+    }
+    else
+    {
+      sweep_residual = sweep(init_flow, circuit_vector[0], concentrate_gerardium, concentrate_waste, parallel);
+    }
+    last_in_old = false;
+
+    // Judge if the circuit has converged
+    bool converge = !single && sweep_residual <= parameters.tolerance;
+
+    result.residual = sweep_residual;
+    if (sample_residuals && Simulation_Statistics::is_checkpoint(i + 1))
+    {
+      statistics.record_residual(i + 1, sweep_residual);
+    }
+
+    // Calculate the recovery and grade of the circuit
+    result.recovery = concentrate_gerardium / init_flow.init_Fg;
+    double concentrate_total = concentrate_gerardium + concentrate_waste;
+    result.grade = concentrate_total > 0.0 ? concentrate_gerardium / concentrate_total : 0.0;
+
+    if (converge)
+    {
+      result.performance = get_performance(concentrate_gerardium, concentrate_waste, eco);
+      result.converged = true;
+      break;
+    }
+
+    // Give up on circuits that cannot reach the threshold
+    if (monitor.enabled())
+    {
+      double monitored_residual = monitor.wants_residual(i + 1) ? sweep_residual : 0.0;
+      if (monitor.hopeless(i + 1, get_performance(concentrate_gerardium, concentrate_waste, eco), monitored_residual))
+      {
+        result.aborted = true;
+        break;
+      }
+    }
+
+    // The next sweep starts from this one: the buffers trade places instead of being copied
+    if (single && sweep_residual < parameters.single_precision_until)
+    {
+      old_flow_G.assign(single_new_G.begin(), single_new_G.end());
+      old_flow_W.assign(single_new_W.begin(), single_new_W.end());
+      single = false;
+      last_in_old = true;
+    }
+    else if (single)
+    {
+      std::swap(single_old_G, single_new_G);
+      std::swap(single_old_W, single_new_W);
+      last_in_old = true;
+    }
+    else if (parameters.solver == Solver_Mode::anderson)
+    {
+      anderson_update(parameters.anderson_depth);
+    }
+    else
+    {
+      std::swap(old_flow_G, new_flow_G);
+      std::swap(old_flow_W, new_flow_W);
+      last_in_old = true;
+    }
+  }
+  result.iterations = result.converged || result.aborted ? i + 1 : i;
+
+  // If the circuit does not converge, set the performance to the feed waste times the penalty
+  if (result.aborted)
+  {
+    result.performance = monitor.estimate;
+  }
+  else if (!result.converged)
+  {
+    result.performance = init_flow.init_Fw * eco.penalty;
+  }
+
+  if (final_state != nullptr)
+  {
+    if (single)
+    {
+      const std::vector<float> &last_G = last_in_old ? single_old_G : single_new_G;
+      const std::vector<float> &last_W = last_in_old ? single_old_W : single_new_W;
+      final_state->flow_G.assign(last_G.begin(), last_G.end());
+      final_state->flow_W.assign(last_W.begin(), last_W.end());
+    }
+    else
+    {
+      const std::vector<double> &last_G = last_in_old ? old_flow_G : new_flow_G;
+      const std::vector<double> &last_W = last_in_old ? old_flow_W : new_flow_W;
+      final_state->flow_G.assign(last_G.begin(), last_G.end());
+      final_state->flow_W.assign(last_W.begin(), last_W.end());
+    }
+  }
+
+  return result;
+}
+
+/**
+ * @brief Performs one sweep over all units, computing the new input flows from the old ones.
+ *
+ * @param init_flow The flow rates entering the circuit at the feed.
+ * @param start The unit receiving the feed.
+ * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+ * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+ * @param parallel Whether to split the unit loops across OpenMP threads.
+ * @return The residual of the sweep.
+ */
+double SimulationWorkspace::sweep(const Initial_flow &init_flow, int start,
+                                  double &concentrate_gerardium, double &concentrate_waste, bool parallel)
+{
+  return sweep_flows(init_flow, start, old_flow_G.data(), old_flow_W.data(), new_flow_G.data(), new_flow_W.data(),
+                     output_G.data(), output_W.data(), concentrate_gerardium, concentrate_waste, parallel);
+}
+
+/**
+ * @brief Performs one sweep over all units with the flows stored in single precision.
+ *
+ * @param init_flow The flow rates entering the circuit at the feed.
+ * @param start The unit receiving the feed.
+ * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+ * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+ * @param parallel Whether to split the unit loops across OpenMP threads.
+ * @return The residual of the sweep.
+ */
+double SimulationWorkspace::sweep_single(const Initial_flow &init_flow, int start,
+                                         double &concentrate_gerardium, double &concentrate_waste, bool parallel)
+{
+  return sweep_flows(init_flow, start, single_old_G.data(), single_old_W.data(), single_new_G.data(), single_new_W.data(),
+                     single_output_G.data(), single_output_W.data(), concentrate_gerardium, concentrate_waste, parallel);
+}
+
+/**
+ * @brief Computes the new input flows from the old ones and the residual in one pass.
+ *
+ * The sweep is split into two scatter-free phases: every unit first splits its old input flow
+ * into its three product streams, then every unit sums the product streams listed in its
+ * incoming rows. Each phase writes only to its own unit, so no atomics are needed and the unit
+ * loops can run in parallel when the caller is not already inside a parallel region. The gather
+ * compares each new flow with the old one while both are loaded, so the convergence test needs
+ * no second pass over the flows. A flow whose relative change is not a number does not count,
+ * as in the original test.
+ *
+ * @tparam Real The type the flows are stored in, double or float.
+ * @param init_flow The flow rates entering the circuit at the feed.
+ * @param start The unit receiving the feed.
+ * @param old_G The old gerardium flow of each unit.
+ * @param old_W The old waste flow of each unit.
+ * @param new_G Receives the new gerardium flow of each unit.
+ * @param new_W Receives the new waste flow of each unit.
+ * @param out_G Receives the gerardium flow of the product streams.
+ * @param out_W Receives the waste flow of the product streams.
+ * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+ * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+ * @param parallel Whether to split the unit loops across OpenMP threads.
+ * @return The largest relative change of a flow rate.
+ */
+template <typename Real>
+double SimulationWorkspace::sweep_flows(const Initial_flow &init_flow, int start, const Real *old_G, const Real *old_W,
+                                        Real *new_G, Real *new_W, Real *out_G, Real *out_W,
+                                        double &concentrate_gerardium, double &concentrate_waste, bool parallel)
+{
+  int length = num_units;
+  const int *conc = conc_num.data();
+  const int *offset = incoming_offset.data();
+  const int *streams = incoming_stream.data();
+
+  // Split the old flow of every unit into its product streams
+  #pragma omp parallel for if(parallel)
+  for (int j = 0; j < length; j++)
+  {
+    struct Flow_rates flows = kernel.unit_flows(old_G[j], old_W[j]);
+    out_G[3 * j] = flows.cg;
+    out_W[3 * j] = flows.cw;
+    out_G[3 * j + 1] = flows.ig;
+    out_W[3 * j + 1] = flows.iw;
+    out_G[3 * j + 2] = flows.tg;
+    out_W[3 * j + 2] = flows.tw;
+  }
+
+  double conc_G = 0.0;
+  double conc_W = 0.0;
+  double largest = 0.0;
+
+  // Gather the new flow rates of the units
+  #pragma omp parallel for reduction(+:conc_G, conc_W) reduction(max:largest) if(parallel)
+  for (int j = 0; j < length; j++)
+  {
+    Real G = j == start ? Real(init_flow.init_Fg) : Real(0);
+    Real W = j == start ? Real(init_flow.init_Fw) : Real(0);
+    for (int e = offset[j]; e < offset[j + 1]; e++)
+    {
+      G += out_G[streams[e]];
+      W += out_W[streams[e]];
+    }
+    new_G[j] = G;
+    new_W[j] = W;
+
+    double diff_fg = std::abs(double(G) - double(old_G[j])) / double(old_G[j]);
+    double diff_fw = std::abs(double(W) - double(old_W[j])) / double(old_W[j]);
+    largest = diff_fg > largest ? diff_fg : largest;
+    largest = diff_fw > largest ? diff_fw : largest;
+
+    if (conc[j] == length) // If the unit points to the concentrate stream
+    {
+      conc_G += out_G[3 * j];
+      conc_W += out_W[3 * j];
+    }
+  }
+
+  concentrate_gerardium = conc_G;
+  concentrate_waste = conc_W;
+  return largest;
+}
+
+/**
+ * @brief Splits the old input flow of every unit into its three product streams.
+ *
+ * @param parallel Whether to split the unit loop across OpenMP threads.
+ */
+void SimulationWorkspace::compute_outputs(bool parallel)
+{
+  int length = num_units;
+  const double *old_G = old_flow_G.data();
+  const double *old_W = old_flow_W.data();
+  double *out_G = output_G.data();
+  double *out_W = output_W.data();
+
+  #pragma omp parallel for if(parallel)
+  for (int j = 0; j < length; j++)
+  {
+    struct Flow_rates flows = kernel.unit_flows(old_G[j], old_W[j]);
+    out_G[3 * j] = flows.cg;
+    out_W[3 * j] = flows.cw;
+    out_G[3 * j + 1] = flows.ig;
+    out_W[3 * j + 1] = flows.iw;
+    out_G[3 * j + 2] = flows.tg;
+    out_W[3 * j + 2] = flows.tw;
+  }
+}
+
+/**
+ * @brief Builds the incoming streams of every unit in compressed rows.
+ *
+ * Each entry indexes a product stream (3 * source + stream) in the cached unit outputs. Streams
+ * leaving the circuit are not listed. Sources are stored in increasing order, which fixes the
+ * summation order of the gather.
+ */
+void SimulationWorkspace::build_incoming()
+{
+  int n = num_units;
+  const int *destinations[3] = {conc_num.data(), inter_num.data(), tails_num.data()};
+
+  // Count the incoming streams of each unit, then fill the rows
+  incoming_offset.assign(n + 1, 0);
+  for (int stream = 0; stream < 3; stream++)
+    for (int u = 0; u < n; u++)
+    {
+      int v = destinations[stream][u];
+      if (v >= 0 && v < n)
+        incoming_offset[v + 1]++;
+    }
+  for (int v = 0; v < n; v++)
+    incoming_offset[v + 1] += incoming_offset[v];
+  incoming_stream.resize(incoming_offset[n]);
+  // unit_order serves as the fill cursor of each row until it is needed for ordering
+  unit_order.resize(n);
+  for (int v = 0; v < n; v++)
+    unit_order[v] = incoming_offset[v];
+  for (int u = 0; u < n; u++)
+    for (int stream = 0; stream < 3; stream++)
+    {
+      int v = destinations[stream][u];
+      if (v >= 0 && v < n)
+        incoming_stream[unit_order[v]++] = 3 * u + stream;
+    }
+
+  output_G.resize(3 * n);
+  output_W.resize(3 * n);
+}
+
+/**
+ * @brief Prepares the feed-first ordering used by the in-place sweep.
+ *
+ * Units are visited breadth-first from the feed unit following the concentrate, intermediate and
+ * tailings streams; units the feed cannot reach are appended in index order. The cached outputs
+ * are then initialised from the starting flows, so the first sweep already reads consistent
+ * values.
+ *
+ * @param start The unit receiving the feed.
+ */
+void SimulationWorkspace::order_units(int start)
+{
+  int n = num_units;
+  const int *destinations[3] = {conc_num.data(), inter_num.data(), tails_num.data()};
+
+  // Breadth-first order from the feed, using unit_order as the queue
+  unit_order.resize(n);
+  unit_visited.assign(n, 0);
+  int head = 0;
+  int tail = 0;
+  if (start >= 0 && start < n)
+  {
+    unit_order[tail++] = start;
+    unit_visited[start] = 1;
+  }
+  int next = 0;
+  while (tail < n)
+  {
+    if (head == tail)
+    {
+      // The remaining units cannot be reached from the feed
+      while (unit_visited[next])
+        next++;
+      unit_order[tail++] = next;
+      unit_visited[next] = 1;
+    }
+    int u = unit_order[head++];
+    for (int stream = 0; stream < 3; stream++)
+    {
+      int v = destinations[stream][u];
+      if (v >= 0 && v < n && !unit_visited[v])
+      {
+        unit_visited[v] = 1;
+        unit_order[tail++] = v;
+      }
+    }
+  }
+
+  // Outputs of every unit for the starting flows
+  compute_outputs(false);
+}
+
+/**
+ * @brief Performs one Gauss-Seidel sweep in the order prepared by order_units.
+ *
+ * Every unit gathers its input from the cached outputs of its sources and immediately refreshes
+ * its own outputs, so units later in the order already see the values of the current sweep.
+ * The new flows are written to new_flow_G and new_flow_W while old_flow_G and old_flow_W keep
+ * the flows of the previous sweep, against which each new flow is checked as soon as it is known.
+ *
+ * @param init_flow The flow rates entering the circuit at the feed.
+ * @param start The unit receiving the feed.
+ * @param concentrate_gerardium Receives the gerardium flow reaching the concentrate outlet.
+ * @param concentrate_waste Receives the waste flow reaching the concentrate outlet.
+ * @return The residual of the sweep.
+ */
+double SimulationWorkspace::sweep_in_place(const Initial_flow &init_flow, int start,
+                                           double &concentrate_gerardium, double &concentrate_waste)
+{
+  int n = num_units;
+  const int *offset = incoming_offset.data();
+  const int *streams = incoming_stream.data();
+  double *out_G = output_G.data();
+  double *out_W = output_W.data();
+
+  double largest = 0.0;
+  for (int k = 0; k < n; k++)
+  {
+    int v = unit_order[k];
+    double G = v == start ? init_flow.init_Fg : 0.0;
+    double W = v == start ? init_flow.init_Fw : 0.0;
+    for (int e = offset[v]; e < offset[v + 1]; e++)
+    {
+      G += out_G[streams[e]];
+      W += out_W[streams[e]];
+    }
+    new_flow_G[v] = G;
+    new_flow_W[v] = W;
+
+    double diff_fg = std::abs(G - old_flow_G[v]) / old_flow_G[v];
+    double diff_fw = std::abs(W - old_flow_W[v]) / old_flow_W[v];
+    largest = diff_fg > largest ? diff_fg : largest;
+    largest = diff_fw > largest ? diff_fw : largest;
+
+    struct Flow_rates flows = kernel.unit_flows(G, W);
+    out_G[3 * v] = flows.cg;
+    out_W[3 * v] = flows.cw;
+    out_G[3 * v + 1] = flows.ig;
+    out_W[3 * v + 1] = flows.iw;
+    out_G[3 * v + 2] = flows.tg;
+    out_W[3 * v + 2] = flows.tw;
+  }
+
+  double conc_G = 0.0;
+  double conc_W = 0.0;
+  for (int u = 0; u < n; u++)
+  {
+    if (conc_num[u] == n) // If the unit points to the concentrate stream
+    {
+      conc_G += out_G[3 * u];
+      conc_W += out_W[3 * u];
+    }
+  }
+  concentrate_gerardium = conc_G;
+  concentrate_waste = conc_W;
+  return largest;
+}
 
 /**
- * @brief Evaluates the performance of a circuit based on a given vector.
+ * @brief Chooses the next iterate with Anderson acceleration.
  *
- * This function simulates the operation of a circuit and calculates its performance.
- * Judge if the circuit has converged (using the difference between the old and new flow rates),
- * if not, set the performance to 90 * -750.
+ * The flow rates x of all units are stacked into one vector and the sweep is treated as a fixed
+ * point map g(x). With f = g(x) - x, the last m differences of f and g are kept and the next
+ * iterate is g(x) - dG * gamma, where gamma minimises |f - dF * gamma| with every flow scaled by
+ * its own magnitude, matching the relative convergence test. Whenever the mixed iterate would
+ * have a negative or non-finite flow, the plain sweep result is used instead and the history is
+ * dropped.
+ *
+ * @param depth The number of previous iterates to mix (m).
+ */
+void SimulationWorkspace::anderson_update(int depth)
+{
+  int n = num_units;
+  int size = 2 * n;
+  depth = std::max(depth, 1);
+
+  anderson_f.resize(size);
+  anderson_f_prev.resize(size);
+  anderson_g_prev.resize(size);
+  anderson_dF.resize(static_cast<size_t>(depth) * size);
+  anderson_dG.resize(static_cast<size_t>(depth) * size);
+  anderson_q.resize(static_cast<size_t>(depth) * size);
+  anderson_r.resize(depth * depth);
+  anderson_gamma.resize(depth);
+  anderson_used.resize(depth);
+  anderson_weight.resize(size);
+
+  // Residual of the current iterate, G followed by W
+  for (int j = 0; j < n; j++)
+  {
+    anderson_f[j] = new_flow_G[j] - old_flow_G[j];
+    anderson_f[n + j] = new_flow_W[j] - old_flow_W[j];
+  }
+
+  // Store the differences to the previous iterate in a ring buffer of columns
+  if (anderson_has_previous)
+  {
+    double *dF = &anderson_dF[static_cast<size_t>(anderson_next) * size];
+    double *dG = &anderson_dG[static_cast<size_t>(anderson_next) * size];
+    for (int k = 0; k < size; k++)
+    {
+      double g = k < n ? new_flow_G[k] : new_flow_W[k - n];
+      dF[k] = anderson_f[k] - anderson_f_prev[k];
+      dG[k] = g - anderson_g_prev[k];
+    }
+    anderson_next = (anderson_next + 1) % depth;
+    anderson_columns = std::min(anderson_columns + 1, depth);
+  }
+  for (int k = 0; k < size; k++)
+  {
+    anderson_f_prev[k] = anderson_f[k];
+    anderson_g_prev[k] = k < n ? new_flow_G[k] : new_flow_W[k - n];
+  }
+  anderson_has_previous = true;
+
+  // The convergence test is relative, so scale every flow by its inverse magnitude
+  for (int k = 0; k < size; k++)
+  {
+    anderson_weight[k] = 1.0 / std::max(std::abs(anderson_g_prev[k]), 1e-150);
+  }
+
+  // Least squares through a modified Gram-Schmidt QR of the scaled dF; columns that are nearly
+  // dependent on the previous ones are dropped rather than allowed to blow up gamma
+  int m = 0;
+  double *Q = anderson_q.data();
+  double *R = anderson_r.data();
+  for (int c = 0; c < anderson_columns; c++)
+  {
+    double *q = &Q[static_cast<size_t>(m) * size];
+    const double *column = &anderson_dF[static_cast<size_t>(c) * size];
+    double original_norm = 0.0;
+    for (int k = 0; k < size; k++)
+    {
+      q[k] = column[k] * anderson_weight[k];
+      original_norm += q[k] * q[k];
+    }
+    for (int p = 0; p < m; p++)
+    {
+      const double *q_p = &Q[static_cast<size_t>(p) * size];
+      double dot = 0.0;
+      for (int k = 0; k < size; k++)
+        dot += q_p[k] * q[k];
+      R[p * depth + m] = dot;
+      for (int k = 0; k < size; k++)
+        q[k] -= dot * q_p[k];
+    }
+    double norm = 0.0;
+    for (int k = 0; k < size; k++)
+      norm += q[k] * q[k];
+    if (!(norm > 1e-20 * original_norm) || !(norm > 0.0))
+      continue;
+    norm = std::sqrt(norm);
+    R[m * depth + m] = norm;
+    for (int k = 0; k < size; k++)
+      q[k] /= norm;
+    anderson_used[m] = c;
+    m++;
+  }
+
+  // Solve R gamma = Q^T f by back substitution
+  double *gamma = anderson_gamma.data();
+  for (int r = 0; r < m; r++)
+  {
+    const double *q = &Q[static_cast<size_t>(r) * size];
+    double dot = 0.0;
+    for (int k = 0; k < size; k++)
+      dot += q[k] * anderson_f[k] * anderson_weight[k];
+    gamma[r] = dot;
+  }
+  for (int r = m - 1; r >= 0; r--)
+  {
+    for (int c = r + 1; c < m; c++)
+      gamma[r] -= R[r * depth + c] * gamma[c];
+    gamma[r] /= R[r * depth + r];
+  }
+  bool solved = m > 0;
+
+  // Mix the history into the next iterate, falling back to the plain sweep if it goes wrong
+  bool accepted = solved;
+  for (int k = 0; k < size && accepted; k++)
+  {
+    double x = anderson_g_prev[k];
+    for (int c = 0; c < m; c++)
+      x -= anderson_dG[static_cast<size_t>(anderson_used[c]) * size + k] * gamma[c];
+    if (!std::isfinite(x) || x < 0.0)
+      accepted = false;
+    else if (k < n)
+      old_flow_G[k] = x;
+    else
+      old_flow_W[k - n] = x;
+  }
+
+  if (!accepted)
+  {
+    for (int j = 0; j < n; j++)
+    {
+      old_flow_G[j] = new_flow_G[j];
+      old_flow_W[j] = new_flow_W[j];
+    }
+    anderson_columns = 0;
+    anderson_next = 0;
+  }
+}
+
+/**
+ * @brief Evaluates the performance of many circuits of the same size.
+ *
+ * @param vector_size The size of every circuit vector.
+ * @param num_circuits The number of circuits.
+ * @param circuit_vectors The circuit vectors, stored one after another.
+ * @param performances Receives the performance value of each circuit.
+ */
+void Evaluate_Circuits_Batch(int vector_size, int num_circuits, int *circuit_vectors, double *performances)
+{
+  static thread_local std::vector<Evaluation_Result> results;
+
+  results.resize(num_circuits);
+  Simulate_Circuits_Batch(vector_size, num_circuits, circuit_vectors, results.data());
+  for (int c = 0; c < num_circuits; c++)
+  {
+    performances[c] = results[c].performance;
+  }
+}
+
+/**
+ * @brief Simulates many circuits of the same size and returns the full results.
+ *
+ * @param vector_size The size of every circuit vector.
+ * @param num_circuits The number of circuits.
+ * @param circuit_vectors The circuit vectors, stored one after another.
+ * @param results Receives one result per circuit.
+ * @param parameters The solver settings.
+ */
+void Simulate_Circuits_Batch(int vector_size, int num_circuits, int *circuit_vectors, Evaluation_Result *results,
+                             const Circuit_Parameters &parameters)
+{
+  // Only the plain double-precision sweep with exact recoveries is vectorised; the other modes,
+  // early aborts and unit-parallel sweeps keep their own per-circuit state
+  if (parameters.solver != Solver_Mode::jacobi || parameters.abort_below > -std::numeric_limits<double>::infinity() ||
+      parameters.recovery_table_error > 0.0 || parameters.single_precision_until > 0.0 || parameters.parallel_units)
+  {
+    for (int c = 0; c < num_circuits; c++)
+    {
+      results[c] = Simulate_Circuit(vector_size, circuit_vectors + static_cast<size_t>(c) * vector_size, parameters);
+    }
+    return;
+  }
+
+  static thread_local BatchWorkspace workspace;
+
+  auto start = std::chrono::steady_clock::now();
+  workspace.simulate(vector_size, num_circuits, circuit_vectors, results, parameters);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  // The lanes share the time, so every circuit is charged an equal part of it
+  Simulation_Statistics &statistics = Local_Simulation_Statistics();
+  for (int c = 0; c < num_circuits; c++)
+  {
+    statistics.record(results[c], elapsed.count() / num_circuits);
+  }
+}
+
+/**
+ * @brief Simulates one circuit under several scenarios in a single pass.
  *
  * @param vector_size The size of the circuit vector.
- * @param circuit_vector The array representing the circuit configuration.
- * @return The performance value of the circuit.
+ * @param circuit_vector The circuit vector.
+ * @param scenarios The parameters of each scenario.
+ * @param results Receives one result per scenario.
  */
+void Simulate_Circuit_Scenarios(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                                std::vector<Evaluation_Result> &results)
+{
+  static thread_local ScenarioWorkspace workspace;
 
-double Evaluate_Circuit(int vector_size, int *circuit_vector)
+  auto start = std::chrono::steady_clock::now();
+  workspace.simulate(vector_size, circuit_vector, scenarios, results);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  // The scenarios share the time, so every one is charged an equal part of it
+  Simulation_Statistics &statistics = Local_Simulation_Statistics();
+  for (const Evaluation_Result &result : results)
+  {
+    statistics.record(result, elapsed.count() / results.size());
+  }
+}
+
+/**
+ * @brief Combines the performances of one circuit under several scenarios.
+ *
+ * @param results The result of each scenario.
+ * @param aggregate How to combine them.
+ * @return The combined performance.
+ */
+double Aggregate_Scenarios(const std::vector<Evaluation_Result> &results, Scenario_Aggregate aggregate)
+{
+  if (results.empty())
+  {
+    return std::numeric_limits<double>::lowest();
+  }
+  double combined = aggregate == Scenario_Aggregate::worst ? results[0].performance : 0.0;
+  for (const Evaluation_Result &result : results)
+  {
+    if (aggregate == Scenario_Aggregate::worst)
+    {
+      combined = std::min(combined, result.performance);
+    }
+    else
+    {
+      combined += result.performance / results.size();
+    }
+  }
+  return combined;
+}
+
+/**
+ * @brief Evaluates the performance of one circuit under several scenarios in a single pass.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param scenarios The parameters of each scenario.
+ * @param aggregate How to combine the performances.
+ * @return The combined performance.
+ */
+double Evaluate_Circuit_Scenarios(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                                  Scenario_Aggregate aggregate)
 {
-  struct Circuit_Parameters default_circuit_parameters;
-  struct Calculate_constants constants;
-  struct Initial_flow init_flow;
-  struct Economic_parameters eco;
+  static thread_local std::vector<Evaluation_Result> results;
 
-  double Performance = 0.0;
-  double Recovery = 0.0;
-  double Grade = 0.0;
+  Simulate_Circuit_Scenarios(vector_size, circuit_vector, scenarios, results);
+  return Aggregate_Scenarios(results, aggregate);
+}
 
-  // Calculate the number of units in the circuit
-  int length = (vector_size - 1) / 3;
-  std::vector<CUnit> units = vector_to_units(circuit_vector, length, init_flow);
-  int i;
-  for (i = 0; i < default_circuit_parameters.max_iterations; i++)
+/**
+ * @brief Loads a circuit into a lane and resets its flows.
+ *
+ * @param lane The lane to fill.
+ * @param circuit_vector The circuit vector.
+ * @param init_flow The initial flow rates.
+ */
+void BatchWorkspace::load_lane(int lane, int *circuit_vector, const Initial_flow &init_flow)
+{
+  start[lane] = circuit_vector[0];
+  iterations[lane] = 0;
+  for (int j = 0; j < num_units; j++)
   {
-    double concentrate_gerardium = 0.0;
-    double concentrate_waste = 0.0;
+    for (int stream = 0; stream < 3; stream++)
+    {
+      destination[(3 * j + stream) * lanes + lane] = circuit_vector[3 * j + 1 + stream];
+    }
+    old_flow_G[j * lanes + lane] = init_flow.init_Fg;
+    old_flow_W[j * lanes + lane] = init_flow.init_Fw;
+  }
+}
+
+/**
+ * @brief Simulates a batch of circuits with plain fixed-point sweeps.
+ *
+ * Every sweep advances all lanes together. After each sweep the lanes whose circuit converged
+ * or ran out of iterations store their result and take the next circuit of the batch; lanes
+ * left without a circuit keep sweeping their last one, but are no longer reported.
+ *
+ * @param vector_size The size of every circuit vector.
+ * @param num_circuits The number of circuits.
+ * @param circuit_vectors The circuit vectors, stored one after another.
+ * @param results Receives one result per circuit.
+ * @param parameters The solver settings.
+ */
+void BatchWorkspace::simulate(int vector_size, int num_circuits, int *circuit_vectors, Evaluation_Result *results,
+                              const Circuit_Parameters &parameters)
+{
+  const Initial_flow &init_flow = parameters.feed;
+  const Economic_parameters &eco = parameters.eco;
+  if (!kernel.folds(parameters.constants))
+  {
+    kernel = Recovery_Kernel(parameters.constants);
+  }
+
+  if (num_circuits <= 0)
+  {
+    return;
+  }
+  if (parameters.max_iterations <= 0)
+  {
+    for (int c = 0; c < num_circuits; c++)
+    {
+      results[c] = Evaluation_Result();
+      results[c].performance = init_flow.init_Fw * eco.penalty;
+    }
+    return;
+  }
+
+  int n = (vector_size - 1) / 3;
+  num_units = n;
+  destination.resize(3 * n * lanes);
+  old_flow_G.resize(n * lanes);
+  old_flow_W.resize(n * lanes);
+  new_flow_G.resize(n * lanes);
+  new_flow_W.resize(n * lanes);
+  output_G.resize(3 * n * lanes);
+  output_W.resize(3 * n * lanes);
+
+  // Fill the lanes; spare lanes replay the first circuit without reporting it
+  int next = 0;
+  int active = 0;
+  for (int l = 0; l < lanes; l++)
+  {
+    if (next < num_circuits)
+    {
+      circuit[l] = next;
+      load_lane(l, circuit_vectors + static_cast<size_t>(next) * vector_size, init_flow);
+      next++;
+      active++;
+    }
+    else
+    {
+      circuit[l] = -1;
+      load_lane(l, circuit_vectors, init_flow);
+    }
+  }
+
+  Simulation_Statistics &statistics = Local_Simulation_Statistics();
+  bool sample_residuals = Simulation_Statistics::sampling_residuals();
+  while (active > 0)
+  {
+    sweep(kernel, init_flow);
 
-    // Update the flow rates for the units
-    #pragma omp parallel for reduction(+:concentrate_gerardium, concentrate_waste)
-    for (int j = 0; j < length; j++)
+    // Residual and convergence mask of every lane, using the same relative test as the single circuit
+    for (int l = 0; l < lanes; l++)
+    {
+      residual[l] = 0.0;
+    }
+    for (int j = 0; j < n; j++)
+    {
+      const double *old_G = &old_flow_G[j * lanes];
+      const double *old_W = &old_flow_W[j * lanes];
+      const double *new_G = &new_flow_G[j * lanes];
+      const double *new_W = &new_flow_W[j * lanes];
+      #pragma omp simd
+      for (int l = 0; l < lanes; l++)
+      {
+        double diff_fg = std::abs(new_G[l] - old_G[l]) / old_G[l];
+        double diff_fw = std::abs(new_W[l] - old_W[l]) / old_W[l];
+        residual[l] = diff_fg > residual[l] ? diff_fg : residual[l];
+        residual[l] = diff_fw > residual[l] ? diff_fw : residual[l];
+      }
+    }
+    for (int l = 0; l < lanes; l++)
     {
-      double tau = calculate_residence_time(constants, units[j].old_flow_W, units[j].old_flow_G);
-      struct Recovery recovery = calculate_recovery(constants, tau);
-      std::vector<double> all_flow_rate = calculate_flow_rate(constants, recovery, units[j].old_flow_G, units[j].old_flow_W);
+      converged[l] = !(residual[l] > parameters.tolerance);
+    }
+
+    // The next sweep starts from this one; refilled lanes are loaded into the swapped buffers
+    std::swap(old_flow_G, new_flow_G);
+    std::swap(old_flow_W, new_flow_W);
 
-      if (units[j].conc_num < length)
+    // Finished lanes report their result and drop out, or take the next circuit
+    for (int l = 0; l < lanes; l++)
+    {
+      if (circuit[l] < 0)
       {
-        #pragma omp atomic
-        units[units[j].conc_num].new_flow_G += all_flow_rate[0];
-        #pragma omp atomic
-        units[units[j].conc_num].new_flow_W += all_flow_rate[1];
+        continue;
       }
-      else if (units[j].conc_num == length) // If the unit points to the concentrate stream
+      iterations[l]++;
+      if (sample_residuals && Simulation_Statistics::is_checkpoint(iterations[l]))
       {
-        concentrate_gerardium += all_flow_rate[0];
-        concentrate_waste += all_flow_rate[1];
+        statistics.record_residual(iterations[l], residual[l]);
       }
-
-      if (units[j].inter_num < length)
+      if (!converged[l] && iterations[l] < parameters.max_iterations)
       {
-        #pragma omp atomic
-        units[units[j].inter_num].new_flow_G += all_flow_rate[2];
-        #pragma omp atomic
-        units[units[j].inter_num].new_flow_W += all_flow_rate[3];
+        continue;
       }
 
-      if (units[j].tails_num < length)
+      Evaluation_Result &result = results[circuit[l]];
+      result.recovery = concentrate_G[l] / init_flow.init_Fg;
+      double concentrate_total = concentrate_G[l] + concentrate_W[l];
+      result.grade = concentrate_total > 0.0 ? concentrate_G[l] / concentrate_total : 0.0;
+      result.converged = converged[l];
+      result.iterations = iterations[l];
+      result.residual = residual[l];
+      result.performance = converged[l] ? get_performance(concentrate_G[l], concentrate_W[l], eco)
+                                        : init_flow.init_Fw * eco.penalty;
+
+      if (next < num_circuits)
+      {
+        circuit[l] = next;
+        load_lane(l, circuit_vectors + static_cast<size_t>(next) * vector_size, init_flow);
+        next++;
+      }
+      else
       {
-        #pragma omp atomic
-        units[units[j].tails_num].new_flow_G += all_flow_rate[4];
-        #pragma omp atomic
-        units[units[j].tails_num].new_flow_W += all_flow_rate[5];
+        circuit[l] = -1;
+        active--;
       }
     }
+  }
+}
+
+/**
+ * @brief Computes the new input flows of all units in all lanes from the old ones.
+ *
+ * The product streams of one unit are computed for every lane in one vectorised loop, then
+ * added to their destinations. Streams are added in increasing source unit order, the same
+ * order as the single circuit gather, so both give the same sums.
+ *
+ * @param kernel The folded constants used for calculation.
+ * @param init_flow The flow rates entering the circuit at the feed.
+ */
+void BatchWorkspace::sweep(const Recovery_Kernel &kernel, const Initial_flow &init_flow)
+{
+  int n = num_units;
+  double *new_G = new_flow_G.data();
+  double *new_W = new_flow_W.data();
 
-    // Add initial flow to the start unit
-    int start = circuit_vector[0];
-    units[start].new_flow_G += init_flow.init_Fg;
-    units[start].new_flow_W += init_flow.init_Fw;
+  // Split the old flow of every unit into its product streams
+  for (int j = 0; j < n; j++)
+  {
+    const double *old_G = &old_flow_G[j * lanes];
+    const double *old_W = &old_flow_W[j * lanes];
+    double *out_G = &output_G[3 * j * lanes];
+    double *out_W = &output_W[3 * j * lanes];
+    #pragma omp simd
+    for (int l = 0; l < lanes; l++)
+    {
+      struct Flow_rates flows = kernel.unit_flows(old_G[l], old_W[l]);
+      out_G[l] = flows.cg;
+      out_W[l] = flows.cw;
+      out_G[lanes + l] = flows.ig;
+      out_W[lanes + l] = flows.iw;
+      out_G[2 * lanes + l] = flows.tg;
+      out_W[2 * lanes + l] = flows.tw;
+    }
+  }
 
-    // Judge if the circuit has converged
-    bool converge = true;
-    for (int j = 0; j < length; j++)
+  // Feed
+  for (int j = 0; j < n; j++)
+  {
+    #pragma omp simd
+    for (int l = 0; l < lanes; l++)
     {
-      // Calculate the relative difference between the old and new flow rates
-      double diff_fg = std::abs(units[j].new_flow_G - units[j].old_flow_G) / units[j].old_flow_G;
-      double diff_fw = std::abs(units[j].new_flow_W - units[j].old_flow_W) / units[j].old_flow_W;
+      new_G[j * lanes + l] = start[l] == j ? init_flow.init_Fg : 0.0;
+      new_W[j * lanes + l] = start[l] == j ? init_flow.init_Fw : 0.0;
+    }
+  }
+  for (int l = 0; l < lanes; l++)
+  {
+    concentrate_G[l] = 0.0;
+    concentrate_W[l] = 0.0;
+  }
 
-      if ((diff_fg > 1e-6 || diff_fw > 1e-6))
+  // Route every product stream; each lane writes only its own column
+  for (int k = 0; k < 3 * n; k++)
+  {
+    const int *dest = &destination[k * lanes];
+    const double *out_G = &output_G[k * lanes];
+    const double *out_W = &output_W[k * lanes];
+    bool concentrate_stream = k % 3 == 0;
+    #pragma omp simd
+    for (int l = 0; l < lanes; l++)
+    {
+      int d = dest[l];
+      if (d >= 0 && d < n)
       {
-        converge = false;
-        break;
+        new_G[d * lanes + l] += out_G[l];
+        new_W[d * lanes + l] += out_W[l];
+      }
+      else if (concentrate_stream && d == n)
+      {
+        concentrate_G[l] += out_G[l];
+        concentrate_W[l] += out_W[l];
       }
     }
+  }
+}
 
-    if (converge)
+/**
+ * @brief Simulates a circuit under every scenario with plain fixed-point sweeps.
+ *
+ * All scenarios sweep together until each has converged or the iterations run out. A scenario
+ * takes its result from the sweep in which it first converges; later sweeps leave it unchanged.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param scenarios The parameters of each scenario, at least one.
+ * @param results Receives one result per scenario.
+ */
+void ScenarioWorkspace::simulate(int vector_size, int *circuit_vector, const std::vector<Circuit_Parameters> &scenarios,
+                                 std::vector<Evaluation_Result> &results)
+{
+  int n = (vector_size - 1) / 3;
+  int k = static_cast<int>(scenarios.size());
+  num_units = n;
+  num_scenarios = k;
+  results.assign(k, Evaluation_Result());
+  if (k == 0)
+  {
+    return;
+  }
+  const Circuit_Parameters &solver = scenarios[0];
+
+  destination.assign(circuit_vector + 1, circuit_vector + 1 + 3 * n);
+  old_flow_G.resize(n * k);
+  old_flow_W.resize(n * k);
+  new_flow_G.resize(n * k);
+  new_flow_W.resize(n * k);
+  output_G.resize(3 * n * k);
+  output_W.resize(3 * n * k);
+  inverse_residence_scale.resize(k);
+  k_concentrate_gerardium.resize(k);
+  k_inter_gerardium.resize(k);
+  k_concentrate_waste.resize(k);
+  k_inter_waste.resize(k);
+  k_sum_gerardium.resize(k);
+  k_sum_waste.resize(k);
+  feed_G.resize(k);
+  feed_W.resize(k);
+  concentrate_G.assign(k, 0.0);
+  concentrate_W.assign(k, 0.0);
+  residual.assign(k, 0.0);
+  finished.assign(k, 0);
+
+  // Fold the constants of every scenario, as a Recovery_Kernel would
+  for (int s = 0; s < k; s++)
+  {
+    Recovery_Kernel kernel(scenarios[s].constants);
+    inverse_residence_scale[s] = kernel.inverse_residence_scale;
+    k_concentrate_gerardium[s] = kernel.k_concentrate_gerardium;
+    k_inter_gerardium[s] = kernel.k_inter_gerardium;
+    k_concentrate_waste[s] = kernel.k_concentrate_waste;
+    k_inter_waste[s] = kernel.k_inter_waste;
+    k_sum_gerardium[s] = kernel.k_sum_gerardium;
+    k_sum_waste[s] = kernel.k_sum_waste;
+    feed_G[s] = scenarios[s].feed.init_Fg;
+    feed_W[s] = scenarios[s].feed.init_Fw;
+  }
+  for (int j = 0; j < n; j++)
+  {
+    std::copy(feed_G.begin(), feed_G.end(), old_flow_G.begin() + j * k);
+    std::copy(feed_W.begin(), feed_W.end(), old_flow_W.begin() + j * k);
+  }
+
+  int remaining = k;
+  for (int i = 0; i < solver.max_iterations && remaining > 0; i++)
+  {
+    sweep(circuit_vector[0]);
+
+    // Residual of every scenario, using the same relative test as the single circuit
+    std::fill(residual.begin(), residual.end(), 0.0);
+    double *res = residual.data();
+    for (int j = 0; j < n; j++)
     {
-      // std::cout << i << std::endl;
-      // std::cout << concentrate_gerardium << " " << concentrate_waste << std::endl;
-      // You can remove the comments above to see the number of iterations and the final concentrate values
-      Performance = get_performance(concentrate_gerardium, concentrate_waste, eco);
-      break;
+      const double *old_G = &old_flow_G[j * k];
+      const double *old_W = &old_flow_W[j * k];
+      const double *new_G = &new_flow_G[j * k];
+      const double *new_W = &new_flow_W[j * k];
+      #pragma omp simd
+      for (int s = 0; s < k; s++)
+      {
+        double diff_fg = std::abs(new_G[s] - old_G[s]) / old_G[s];
+        double diff_fw = std::abs(new_W[s] - old_W[s]) / old_W[s];
+        res[s] = diff_fg > res[s] ? diff_fg : res[s];
+        res[s] = diff_fw > res[s] ? diff_fw : res[s];
+      }
     }
-    else
+
+    // Scenarios that converged, or ran out of iterations, report their result
+    for (int s = 0; s < k; s++)
     {
-      for (int j = 0; j < length; j++)
+      bool converged = !(residual[s] > solver.tolerance);
+      if (finished[s] || (!converged && i + 1 < solver.max_iterations))
       {
-        units[j].old_flow_G = units[j].new_flow_G;
-        units[j].old_flow_W = units[j].new_flow_W;
-        units[j].new_flow_G = 0.0;
-        units[j].new_flow_W = 0.0;
+        continue;
       }
+      Evaluation_Result &result = results[s];
+      result.recovery = concentrate_G[s] / feed_G[s];
+      double concentrate_total = concentrate_G[s] + concentrate_W[s];
+      result.grade = concentrate_total > 0.0 ? concentrate_G[s] / concentrate_total : 0.0;
+      result.converged = converged;
+      result.iterations = i + 1;
+      result.residual = residual[s];
+      result.performance = converged ? get_performance(concentrate_G[s], concentrate_W[s], scenarios[s].eco)
+                                     : feed_W[s] * scenarios[s].eco.penalty;
+      finished[s] = 1;
+      remaining--;
+    }
+
+    // The next sweep starts from this one
+    std::swap(old_flow_G, new_flow_G);
+    std::swap(old_flow_W, new_flow_W);
+  }
+
+  // Without any sweep, every scenario earns the penalty
+  for (int s = 0; s < k; s++)
+  {
+    if (!finished[s])
+    {
+      results[s].performance = feed_W[s] * scenarios[s].eco.penalty;
+    }
+  }
+}
+
+/**
+ * @brief Computes the new input flows of all units in all scenarios from the old ones.
+ *
+ * Mirrors Recovery_Kernel::unit_flows with the constants of each lane, then routes every
+ * stream once for all scenarios, in increasing source unit order like the single circuit.
+ *
+ * @param start The unit receiving the feed.
+ */
+void ScenarioWorkspace::sweep(int start)
+{
+  int n = num_units;
+  int k = num_scenarios;
+  double *new_G = new_flow_G.data();
+  double *new_W = new_flow_W.data();
+  const double *inverse_scale = inverse_residence_scale.data();
+  const double *kcg = k_concentrate_gerardium.data();
+  const double *kig = k_inter_gerardium.data();
+  const double *kcw = k_concentrate_waste.data();
+  const double *kiw = k_inter_waste.data();
+  const double *ksg = k_sum_gerardium.data();
+  const double *ksw = k_sum_waste.data();
+
+  // Split the old flow of every unit into its product streams
+  for (int j = 0; j < n; j++)
+  {
+    const double *old_G = &old_flow_G[j * k];
+    const double *old_W = &old_flow_W[j * k];
+    double *out_G = &output_G[3 * j * k];
+    double *out_W = &output_W[3 * j * k];
+    #pragma omp simd
+    for (int s = 0; s < k; s++)
+    {
+      double Fg = old_G[s];
+      double Fw = old_W[s];
+      double x = std::max(Fg + Fw, 1e-10) * inverse_scale[s];
+      double gerardium = Fg / (x + ksg[s]);
+      double waste = Fw / (x + ksw[s]);
+      double cg = kcg[s] * gerardium;
+      double cw = kcw[s] * waste;
+      double ig = kig[s] * gerardium;
+      double iw = kiw[s] * waste;
+      out_G[s] = cg;
+      out_W[s] = cw;
+      out_G[k + s] = ig;
+      out_W[k + s] = iw;
+      out_G[2 * k + s] = Fg - cg - ig;
+      out_W[2 * k + s] = Fw - cw - iw;
     }
-    // Calculate the recovery and grade of the circuit
-    Recovery = concentrate_gerardium / init_flow.init_Fg;
-    Grade = concentrate_gerardium / (concentrate_gerardium + concentrate_waste);
   }
 
-  // If the circuit does not converge, set the performance to 90 * -750
-  if (i == 1000)
+  // Feed
+  std::fill(new_flow_G.begin(), new_flow_G.end(), 0.0);
+  std::fill(new_flow_W.begin(), new_flow_W.end(), 0.0);
+  if (start >= 0 && start < n)
   {
-    Performance = init_flow.init_Fw * eco.penalty;
+    std::copy(feed_G.begin(), feed_G.end(), new_flow_G.begin() + start * k);
+    std::copy(feed_W.begin(), feed_W.end(), new_flow_W.begin() + start * k);
   }
+  std::fill(concentrate_G.begin(), concentrate_G.end(), 0.0);
+  std::fill(concentrate_W.begin(), concentrate_W.end(), 0.0);
 
-  try
+  // Route every product stream; the destination is the same in every scenario
+  double *conc_G = concentrate_G.data();
+  double *conc_W = concentrate_W.data();
+  for (int stream = 0; stream < 3 * n; stream++)
   {
-    // Write the performance, recovery, and grade to a file
-    std::ofstream outFile("./output/performance.dat");
+    int d = destination[stream];
+    const double *out_G = &output_G[stream * k];
+    const double *out_W = &output_W[stream * k];
+    double *to_G = nullptr;
+    double *to_W = nullptr;
+    if (d >= 0 && d < n)
+    {
+      to_G = new_G + d * k;
+      to_W = new_W + d * k;
+    }
+    else if (stream % 3 == 0 && d == n)
+    {
+      to_G = conc_G;
+      to_W = conc_W;
+    }
+    else
+    {
+      continue;
+    }
+    #pragma omp simd
+    for (int s = 0; s < k; s++)
+    {
+      to_G[s] += out_G[s];
+      to_W[s] += out_W[s];
+    }
+  }
+}
+
+/**
+ * @brief Folds the constants of the calculation into a recovery kernel.
+ *
+ * @param constants The constants used for calculation.
+ */
+Recovery_Kernel::Recovery_Kernel(const Calculate_constants &constants)
+    : residence_scale(constants.rho * constants.phi * constants.V),
+      inverse_residence_scale(1.0 / (constants.rho * constants.phi * constants.V)),
+      k_concentrate_gerardium(constants.k_concentrate_gerardium),
+      k_inter_gerardium(constants.k_inter_gerardium),
+      k_concentrate_waste(constants.k_concentrate_waste),
+      k_inter_waste(constants.k_inter_waste),
+      k_sum_gerardium(constants.k_concentrate_gerardium + constants.k_inter_gerardium),
+      k_sum_waste(constants.k_concentrate_waste + constants.k_inter_waste)
+{
+}
 
-    outFile << Performance << "\n";
-    outFile << Recovery << "\n";
-    outFile << Grade << "\n";
+/**
+ * @brief Builds the recovery table for a given interpolation error, or drops it.
+ *
+ * Linear interpolation with spacing h is off by at most h * h / 8 * max |r''|. Every recovery
+ * r = k * tau / (1 + s * tau) has |r''| = 2 * k * s / (1 + s * tau)^3, which is largest at tau = 0,
+ * so a uniform grid with h = sqrt(8 * max_error / (2 * k * s)) keeps the bound everywhere.
+ *
+ * @param max_error The largest accepted interpolation error; 0 or less computes exactly.
+ * @param max_tau The largest tabulated residence time; 0 or less covers a total flow of 1.
+ */
+void Recovery_Kernel::tabulate(double max_error, double max_tau)
+{
+  const int max_intervals = 1 << 16;
 
-    outFile.close();
+  table.clear();
+  table_error = 0.0;
+  table_max_tau = 0.0;
+  table_inverse_step = 0.0;
+  if (max_error <= 0.0)
+  {
+    return;
   }
-  catch (const std::exception &e)
+  if (max_tau <= 0.0)
   {
+    max_tau = residence_scale;
   }
 
-  return Performance;
+  double curvature = 2.0 * std::max({k_concentrate_gerardium * k_sum_gerardium, k_inter_gerardium * k_sum_gerardium,
+                                     k_concentrate_waste * k_sum_waste, k_inter_waste * k_sum_waste});
+  double step = curvature > 0.0 ? std::min(std::sqrt(8.0 * max_error / curvature), max_tau) : max_tau;
+  // A grid too fine to store is shortened rather than coarsened, so the bound still holds
+  int intervals = static_cast<int>(std::min(std::ceil(max_tau / step), static_cast<double>(max_intervals)));
+
+  // One spare node covers rounding of tau * inverse step at the end of the grid
+  table.resize(4 * (intervals + 2));
+  for (int node = 0; node < intervals + 2; node++)
+  {
+    double tau = node * step;
+    table[4 * node] = k_concentrate_gerardium * tau / (1 + k_sum_gerardium * tau);
+    table[4 * node + 1] = k_concentrate_waste * tau / (1 + k_sum_waste * tau);
+    table[4 * node + 2] = k_inter_gerardium * tau / (1 + k_sum_gerardium * tau);
+    table[4 * node + 3] = k_inter_waste * tau / (1 + k_sum_waste * tau);
+  }
+  table_error = max_error;
+  table_max_tau = intervals * step;
+  table_inverse_step = 1.0 / step;
 }
 
 /**
@@ -187,6 +1667,21 @@ struct Recovery calculate_recovery(const Calculate_constants &constants, double
  * @return The calculated flow rates.
  */
 std::vector<double> calculate_flow_rate(const Calculate_constants &constants, Recovery &recovery, double init_Fg, double init_Fw)
+{
+  struct Flow_rates flows = calculate_unit_flows(recovery, init_Fg, init_Fw);
+
+  return {flows.cg, flows.cw, flows.ig, flows.iw, flows.tg, flows.tw};
+};
+
+/**
+ * @brief Calculates the flow rates of materials in a unit without allocating.
+ *
+ * @param recovery The recovery of materials in the unit.
+ * @param init_Fg Input flow rate of gerardium.
+ * @param init_Fw Input flow rate of waste.
+ * @return The calculated flow rates.
+ */
+struct Flow_rates calculate_unit_flows(const Recovery &recovery, double init_Fg, double init_Fw)
 {
   double cg = init_Fg * recovery.concentrate_gerardium;
   double cw = init_Fw * recovery.concentrate_waste;
@@ -195,7 +1690,8 @@ std::vector<double> calculate_flow_rate(const Calculate_constants &constants, Re
   double tg = init_Fg - cg - ig;
   double tw = init_Fw - cw - iw;
 
-  return {cg, cw, ig, iw, tg, tw};
+  struct Flow_rates flows = {cg, cw, ig, iw, tg, tw};
+  return flows;
 };
 
 /**
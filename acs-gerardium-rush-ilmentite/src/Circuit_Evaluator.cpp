@@ -0,0 +1,326 @@
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Circuit_Evaluator.h"
+
+
+/**
+ * @brief Reads a whole string as a number.
+ *
+ * @param value The text to read.
+ * @param number Receives the number.
+ * @return True if the text is one finite number and nothing else.
+ */
+static bool read_number(const std::string &value, double &number) {
+    const char *begin = value.c_str();
+    char *end = nullptr;
+    errno = 0;
+    number = std::strtod(begin, &end);
+    return end != begin && *end == '\0' && errno == 0 && std::isfinite(number);
+}
+
+/**
+ * @brief Reads a whole string as an integer.
+ *
+ * @param value The text to read.
+ * @param number Receives the integer, if the text is one.
+ * @return True if the text is one integer and nothing else.
+ */
+static bool read_integer(const std::string &value, int &number) {
+    const char *begin = value.c_str();
+    char *end = nullptr;
+    errno = 0;
+    long parsed = std::strtol(begin, &end, 10);
+    if (end == begin || *end != '\0' || errno != 0 || parsed != static_cast<int>(parsed)) {
+        return false;
+    }
+    number = static_cast<int>(parsed);
+    return true;
+}
+
+/**
+ * @brief Reads a string as a flag.
+ *
+ * @param value The text to read: true, false, 1 or 0.
+ * @param flag Receives the flag.
+ * @return True if the text is one of the accepted spellings.
+ */
+static bool read_flag(const std::string &value, bool &flag) {
+    if (value == "true" || value == "1") {
+        flag = true;
+        return true;
+    }
+    if (value == "false" || value == "0") {
+        flag = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Reads a string as a solver mode.
+ *
+ * @param value The name of the mode.
+ * @param solver Receives the mode.
+ * @return True if the name is known.
+ */
+static bool read_solver(const std::string &value, Solver_Mode &solver) {
+    if (value == "jacobi") {
+        solver = Solver_Mode::jacobi;
+    } else if (value == "anderson") {
+        solver = Solver_Mode::anderson;
+    } else if (value == "gauss_seidel") {
+        solver = Solver_Mode::gauss_seidel;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Removes the white space around a string.
+ *
+ * @param text The string.
+ * @return The string without leading and trailing white space.
+ */
+static std::string trim(const std::string &text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+
+/**
+ * Simulates a circuit with the evaluator's parameters.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return The result of the simulation.
+ */
+Evaluation_Result Circuit_Evaluator::simulate(int vector_size, int *circuit_vector) const {
+    return Simulate_Circuit(vector_size, circuit_vector, parameters);
+}
+
+/**
+ * Evaluates the performance of a circuit with the evaluator's parameters.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return The performance value.
+ */
+double Circuit_Evaluator::operator()(int vector_size, int *circuit_vector) const {
+    return Simulate_Circuit(vector_size, circuit_vector, parameters).performance;
+}
+
+/**
+ * Evaluates the performance of a circuit with the evaluator's parameters and a threshold.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param threshold The performance worth simulating for.
+ * @return The performance value, or a prediction below the threshold.
+ */
+double Circuit_Evaluator::operator()(int vector_size, int *circuit_vector, double threshold) const {
+    Circuit_Parameters bounded = parameters;
+    bounded.abort_below = threshold;
+    return Simulate_Circuit(vector_size, circuit_vector, bounded).performance;
+}
+
+
+/**
+ * Creates an evaluator combining the scenarios with a built-in aggregate.
+ *
+ * @param scenarios The parameters of each scenario.
+ * @param aggregate How to combine the performances.
+ */
+Scenario_Evaluator::Scenario_Evaluator(const std::vector<Circuit_Parameters> &scenarios, Scenario_Aggregate aggregate)
+    : scenarios(scenarios),
+      aggregate([aggregate](const std::vector<Evaluation_Result> &results) {
+          return Aggregate_Scenarios(results, aggregate);
+      }) {
+}
+
+/**
+ * Creates an evaluator combining the scenarios with a user-supplied aggregate.
+ *
+ * @param scenarios The parameters of each scenario.
+ * @param aggregate Maps the result of every scenario to one fitness.
+ */
+Scenario_Evaluator::Scenario_Evaluator(const std::vector<Circuit_Parameters> &scenarios,
+                                       std::function<double(const std::vector<Evaluation_Result> &)> aggregate)
+    : scenarios(scenarios), aggregate(aggregate) {
+}
+
+/**
+ * Simulates a circuit under every scenario in one pass.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param results Receives one result per scenario.
+ */
+void Scenario_Evaluator::simulate(int vector_size, int *circuit_vector, std::vector<Evaluation_Result> &results) const {
+    Simulate_Circuit_Scenarios(vector_size, circuit_vector, scenarios, results);
+}
+
+/**
+ * Evaluates the combined performance of a circuit, reusing a per-thread result buffer.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @return The performances of the scenarios, combined.
+ */
+double Scenario_Evaluator::operator()(int vector_size, int *circuit_vector) const {
+    static thread_local std::vector<Evaluation_Result> results;
+    Simulate_Circuit_Scenarios(vector_size, circuit_vector, scenarios, results);
+    return aggregate(results);
+}
+
+
+/**
+ * Looks the key up in a table of the settings and reads the value with the reader of its type.
+ * Numbers that make no physical sense, such as a negative volume, are left to the simulation.
+ *
+ * @param parameters The parameters to change.
+ * @param key The key of the setting, section.name.
+ * @param value The new value.
+ * @param error Receives a message if the key is unknown or the value cannot be read.
+ * @return True if the parameter was set.
+ */
+bool Set_Circuit_Parameter(Circuit_Parameters &parameters, const std::string &key, const std::string &value,
+                           std::string &error) {
+    struct Number_Setting {
+        const char *key;
+        double *target;
+    };
+    Number_Setting numbers[] = {
+        {"solver.tolerance", &parameters.tolerance},
+        {"solver.recovery_table_error", &parameters.recovery_table_error},
+        {"solver.single_precision_until", &parameters.single_precision_until},
+        {"constants.rho", &parameters.constants.rho},
+        {"constants.phi", &parameters.constants.phi},
+        {"constants.V", &parameters.constants.V},
+        {"constants.k_concentrate_gerardium", &parameters.constants.k_concentrate_gerardium},
+        {"constants.k_inter_gerardium", &parameters.constants.k_inter_gerardium},
+        {"constants.k_concentrate_waste", &parameters.constants.k_concentrate_waste},
+        {"constants.k_inter_waste", &parameters.constants.k_inter_waste},
+        {"feed.init_Fg", &parameters.feed.init_Fg},
+        {"feed.init_Fw", &parameters.feed.init_Fw},
+        {"economics.price", &parameters.eco.price},
+        {"economics.penalty", &parameters.eco.penalty},
+    };
+
+    bool known = true;
+    bool readable = false;
+    if (key == "solver.max_iterations") {
+        readable = read_integer(value, parameters.max_iterations);
+    } else if (key == "solver.anderson_depth") {
+        readable = read_integer(value, parameters.anderson_depth);
+    } else if (key == "solver.parallel_units") {
+        readable = read_flag(value, parameters.parallel_units);
+    } else if (key == "solver.method") {
+        readable = read_solver(value, parameters.solver);
+    } else {
+        known = false;
+        for (const Number_Setting &setting : numbers) {
+            if (key == setting.key) {
+                known = true;
+                double number = 0.0;
+                readable = read_number(value, number);
+                if (readable) {
+                    *setting.target = number;
+                }
+                break;
+            }
+        }
+    }
+
+    if (!known) {
+        error = "unknown parameter '" + key + "'";
+    } else if (!readable) {
+        error = "invalid value '" + value + "' for " + key;
+    }
+    return known && readable;
+}
+
+
+/**
+ * Reads the file line by line, keeping track of the current [section] and setting
+ * section.name for every name = value line.
+ *
+ * @param filename The file to read.
+ * @param parameters The parameters to change.
+ * @param error Receives a message naming the file and line if reading fails.
+ * @return True if the file was read and every setting in it was valid.
+ */
+bool Read_Circuit_Config(const std::string &filename, Circuit_Parameters &parameters, std::string &error) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        error = "cannot open " + filename;
+        return false;
+    }
+
+    std::string section;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        std::string location = filename + ":" + std::to_string(line_number) + ": ";
+        if (line.front() == '[' && line.back() == ']') {
+            section = trim(line.substr(1, line.size() - 2));
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            error = location + "expected name = value";
+            return false;
+        }
+        std::string key = section + "." + trim(line.substr(0, equals));
+        if (!Set_Circuit_Parameter(parameters, key, trim(line.substr(equals + 1)), error)) {
+            error = location + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Applies the parameter flags in the order given, so a flag after --config overrides the file.
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param parameters The parameters to change.
+ * @param remaining Receives the arguments that are not parameters.
+ * @param error Receives a message if a flag or configuration file is invalid.
+ * @return True if every parameter flag was valid.
+ */
+bool Parse_Circuit_Arguments(int argc, char *argv[], Circuit_Parameters &parameters,
+                             std::vector<std::string> &remaining, std::string &error) {
+    remaining.clear();
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        size_t equals = argument.find('=');
+        std::string key = equals == std::string::npos ? "" : argument.substr(2, equals - 2);
+        if (argument.rfind("--", 0) != 0 || (key != "config" && key.find('.') == std::string::npos)) {
+            remaining.push_back(argument);
+            continue;
+        }
+        std::string value = argument.substr(equals + 1);
+        bool set = key == "config" ? Read_Circuit_Config(value, parameters, error)
+                                   : Set_Circuit_Parameter(parameters, key, value, error);
+        if (!set) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "CCircuit.h"
+#include "Delta_Evaluation.h"
+
+
+/**
+ * @brief Checks whether a gene lies in the range the snapshot tables cover.
+ *
+ * @param snapshot The snapshot.
+ * @param value The gene.
+ * @return True if the gene is in 0..n+1.
+ */
+static bool in_range(const Circuit_Snapshot &snapshot, int value) {
+    return value >= 0 && value <= snapshot.num_units + 1;
+}
+
+/**
+ * @brief Checks the conditions of Check_Validity that only look at one unit's own streams.
+ *
+ * Covers the self-recycle, same-destination, outlet-misuse and maximum-value checks.
+ *
+ * @param snapshot The snapshot holding the genes.
+ * @param unit The unit to check.
+ * @return True if the unit fails one of them.
+ */
+static bool unit_is_invalid(const Circuit_Snapshot &snapshot, int unit) {
+    int n = snapshot.num_units;
+    int conc = snapshot.genes[3 * unit + 1];
+    int inter = snapshot.genes[3 * unit + 2];
+    int tails = snapshot.genes[3 * unit + 3];
+
+    return conc == unit || inter == unit || tails == unit ||
+           (conc == inter && inter == tails) ||
+           inter == n || tails == n || conc == n + 1 || inter == n + 1 ||
+           conc > n || inter > n - 1 || tails > n + 1;
+}
+
+/**
+ * @brief Checks whether a unit sends its concentrate to the outlet while fed mostly by tailings.
+ *
+ * @param snapshot The snapshot holding the genes and incoming stream counts.
+ * @param unit The unit to check.
+ * @return True if the unit fails the tailings percentage check.
+ */
+static bool unit_is_tail_heavy(const Circuit_Snapshot &snapshot, int unit) {
+    return snapshot.genes[3 * unit + 1] == snapshot.num_units &&
+           2 * snapshot.incoming_tails[unit] > snapshot.incoming[unit];
+}
+
+/**
+ * @brief Adds (or removes) the current value of one gene to the snapshot's counts.
+ *
+ * @param snapshot The snapshot.
+ * @param gene The index of the gene.
+ * @param sign 1 to add the gene, -1 to remove it.
+ */
+static void count_gene(Circuit_Snapshot &snapshot, int gene, int sign) {
+    int n = snapshot.num_units;
+    int value = snapshot.genes[gene];
+
+    if (!in_range(snapshot, value)) {
+        snapshot.out_of_range += sign;
+        return;
+    }
+    snapshot.value_count[value] += sign;
+    if (gene == 0) {
+        return;
+    }
+
+    int stream = (gene - 1) % 3;
+    if (value < n) {
+        snapshot.incoming[value] += sign;
+        if (stream == 2) {
+            snapshot.incoming_tails[value] += sign;
+        }
+    }
+    if (stream == 0 && value == n) {
+        snapshot.concentrate_units += sign;
+    }
+    if (stream == 2 && value == n + 1) {
+        snapshot.tailings_units += sign;
+    }
+}
+
+/**
+ * @brief Recounts the values missing below the largest value of the vector.
+ *
+ * @param snapshot The snapshot.
+ */
+static void count_missing_values(Circuit_Snapshot &snapshot) {
+    snapshot.max_value = 0;
+    for (int value = snapshot.num_units + 1; value > 0; --value) {
+        if (snapshot.value_count[value] > 0) {
+            snapshot.max_value = value;
+            break;
+        }
+    }
+    snapshot.missing_values = 0;
+    for (int value = 0; value < snapshot.max_value; ++value) {
+        if (snapshot.value_count[value] == 0) {
+            snapshot.missing_values++;
+        }
+    }
+}
+
+/**
+ * @brief Counts the units reachable from unit 0 with a breadth-first search.
+ *
+ * Follows the same streams as Circuit::mark_units: those leading to a unit index.
+ *
+ * @param snapshot The snapshot.
+ */
+static void count_reachable_units(Circuit_Snapshot &snapshot) {
+    int n = snapshot.num_units;
+    std::fill(snapshot.search_mark.begin(), snapshot.search_mark.end(), 0);
+
+    int head = 0, tail = 0;
+    snapshot.search_queue[tail++] = 0;
+    snapshot.search_mark[0] = 1;
+    while (head < tail) {
+        int unit = snapshot.search_queue[head++];
+        for (int stream = 1; stream <= 3; ++stream) {
+            int destination = snapshot.genes[3 * unit + stream];
+            if (destination >= 0 && destination < n && !snapshot.search_mark[destination]) {
+                snapshot.search_mark[destination] = 1;
+                snapshot.search_queue[tail++] = destination;
+            }
+        }
+    }
+    snapshot.reachable_units = tail;
+}
+
+/**
+ * @brief Derives the validity of the circuit from the snapshot's counts.
+ *
+ * @param snapshot The snapshot.
+ * @return The same result as Check_Validity.
+ */
+static bool counts_are_valid(Circuit_Snapshot &snapshot) {
+    if (snapshot.out_of_range > 0) {
+        return Check_Validity(snapshot.vector_size, snapshot.genes.data());
+    }
+    int n = snapshot.num_units;
+    return snapshot.missing_values == 0 &&
+           snapshot.reachable_units == n &&
+           snapshot.invalid_units == 0 &&
+           snapshot.concentrate_units > 0 &&
+           snapshot.tailings_units > 0 &&
+           snapshot.tail_heavy_units == 0 &&
+           snapshot.genes[0] < n;
+}
+
+/**
+ * @brief Simulates a valid circuit and records its fitness.
+ *
+ * @param snapshot The snapshot, whose validity is already known.
+ * @param initial_state Flows to start from, or nullptr for the cold start.
+ * @param parameters The solver settings.
+ */
+static void evaluate(Circuit_Snapshot &snapshot, const Flow_State *initial_state, const Circuit_Parameters &parameters) {
+    if (!snapshot.valid) {
+        snapshot.fitness = std::numeric_limits<double>::lowest();
+        return;
+    }
+    snapshot.result = Simulate_Circuit(snapshot.vector_size, snapshot.genes.data(), parameters,
+                                       initial_state, &snapshot.flows);
+    snapshot.flows_converged = snapshot.result.converged;
+    snapshot.fitness = snapshot.result.performance;
+}
+
+
+/**
+ * Builds every table of the snapshot from the circuit vector, then simulates the circuit from
+ * the cold start.
+ *
+ * @param vector_size The size of the circuit vector.
+ * @param circuit_vector The circuit vector.
+ * @param snapshot Receives the analysis of the circuit.
+ * @param parameters The solver settings.
+ */
+void Analyse_Circuit(int vector_size, int *circuit_vector, Circuit_Snapshot &snapshot,
+                     const Circuit_Parameters &parameters) {
+    int n = (vector_size - 1) / 3;
+    snapshot.vector_size = vector_size;
+    snapshot.num_units = n;
+    snapshot.genes.assign(circuit_vector, circuit_vector + vector_size);
+    snapshot.result = Evaluation_Result();
+    snapshot.flows = Flow_State();
+    snapshot.flows_converged = false;
+
+    if (n < 1 || (vector_size - 1) % 3 != 0) {
+        // Only whole circuits have tables; anything else takes the full check every time
+        snapshot.valid = Check_Validity(vector_size, circuit_vector);
+        evaluate(snapshot, nullptr, parameters);
+        return;
+    }
+
+    snapshot.value_count.assign(n + 2, 0);
+    snapshot.incoming.assign(n, 0);
+    snapshot.incoming_tails.assign(n, 0);
+    snapshot.search_queue.assign(n, 0);
+    snapshot.search_mark.assign(n, 0);
+    snapshot.out_of_range = 0;
+    snapshot.concentrate_units = 0;
+    snapshot.tailings_units = 0;
+    for (int gene = 0; gene < vector_size; ++gene) {
+        count_gene(snapshot, gene, 1);
+    }
+    count_missing_values(snapshot);
+
+    snapshot.invalid_units = 0;
+    snapshot.tail_heavy_units = 0;
+    for (int unit = 0; unit < n; ++unit) {
+        snapshot.invalid_units += unit_is_invalid(snapshot, unit);
+        snapshot.tail_heavy_units += unit_is_tail_heavy(snapshot, unit);
+    }
+    count_reachable_units(snapshot);
+
+    snapshot.valid = counts_are_valid(snapshot);
+    evaluate(snapshot, nullptr, parameters);
+}
+
+
+/**
+ * Applies the changed genes to a copy of the parent's tables. Only the units owning a changed
+ * gene and the units its old and new values point to can change their per-unit checks, so
+ * those are subtracted from the counts before the change and added back after it. Adding a
+ * stream cannot disconnect a unit, so reachability is searched again only when a stream
+ * between two units was removed or the parent was not fully connected.
+ *
+ * @param parent The analysis of the parent circuit.
+ * @param circuit_vector The child circuit vector, of the parent's size.
+ * @param changed_genes Indices of the genes that may differ from the parent.
+ * @param num_changed The number of indices.
+ * @param child Receives the analysis of the child circuit.
+ * @param parameters The solver settings.
+ */
+void Reanalyse_Circuit(const Circuit_Snapshot &parent, int *circuit_vector, const int *changed_genes, int num_changed,
+                       Circuit_Snapshot &child, const Circuit_Parameters &parameters) {
+    int n = parent.num_units;
+    if (n < 1 || (parent.vector_size - 1) % 3 != 0) {
+        Analyse_Circuit(parent.vector_size, circuit_vector, child, parameters);
+        return;
+    }
+    if (&child != &parent) {
+        child = parent;
+    }
+
+    // Units whose per-unit checks may change
+    std::vector<int> affected;
+    affected.reserve(3 * num_changed);
+    for (int i = 0; i < num_changed; ++i) {
+        int gene = changed_genes[i];
+        if (gene == 0 || child.genes[gene] == circuit_vector[gene]) {
+            continue;
+        }
+        affected.push_back((gene - 1) / 3);
+        if (child.genes[gene] >= 0 && child.genes[gene] < n) {
+            affected.push_back(child.genes[gene]);
+        }
+        if (circuit_vector[gene] >= 0 && circuit_vector[gene] < n) {
+            affected.push_back(circuit_vector[gene]);
+        }
+    }
+    std::sort(affected.begin(), affected.end());
+    affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+
+    for (int unit : affected) {
+        child.invalid_units -= unit_is_invalid(child, unit);
+        child.tail_heavy_units -= unit_is_tail_heavy(child, unit);
+    }
+
+    bool removed_link = false;
+    for (int i = 0; i < num_changed; ++i) {
+        int gene = changed_genes[i];
+        int old_value = child.genes[gene];
+        int new_value = circuit_vector[gene];
+        if (old_value == new_value) {
+            continue;
+        }
+        if (gene > 0 && old_value >= 0 && old_value < n) {
+            removed_link = true;
+        }
+
+        count_gene(child, gene, -1);
+        if (in_range(child, old_value) && old_value < child.max_value && child.value_count[old_value] == 0) {
+            child.missing_values++;
+        }
+        child.genes[gene] = new_value;
+        count_gene(child, gene, 1);
+        if (in_range(child, new_value) && new_value < child.max_value && child.value_count[new_value] == 1) {
+            child.missing_values--;
+        }
+        // Leaving the largest value or going above it moves the range that has to be present
+        if ((in_range(child, old_value) && old_value == child.max_value && child.value_count[old_value] == 0) ||
+            (in_range(child, new_value) && new_value > child.max_value)) {
+            count_missing_values(child);
+        }
+    }
+
+    for (int unit : affected) {
+        child.invalid_units += unit_is_invalid(child, unit);
+        child.tail_heavy_units += unit_is_tail_heavy(child, unit);
+    }
+    if (removed_link || parent.reachable_units < n) {
+        count_reachable_units(child);
+    }
+
+    child.valid = counts_are_valid(child);
+    // Start from the parent's steady state; flows that did not converge may be far from any
+    // steady state, so those start cold. A child that fails the checks keeps the parent's
+    // flows, so a later child of it still starts warm.
+    evaluate(child, child.flows_converged ? &child.flows : nullptr, parameters);
+}
+
+
+/**
+ * Lists the genes in which two circuit vectors differ.
+ *
+ * @param vector_size The size of the circuit vectors.
+ * @param parent The parent circuit vector.
+ * @param child The child circuit vector.
+ * @param changed_genes Receives the indices of the differing genes.
+ */
+void Changed_Genes(int vector_size, const int *parent, const int *child, std::vector<int> &changed_genes) {
+    changed_genes.clear();
+    for (int gene = 0; gene < vector_size; ++gene) {
+        if (parent[gene] != child[gene]) {
+            changed_genes.push_back(gene);
+        }
+    }
+}
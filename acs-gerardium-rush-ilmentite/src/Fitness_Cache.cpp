@@ -0,0 +1,150 @@
+#include <algorithm>
+#include "Fitness_Cache.h"
+
+
+/**
+ * Constructs a cache holding at most capacity individuals, split evenly over the shards.
+ *
+ * @param capacity The maximum number of cached individuals; 0 disables the cache.
+ * @param num_shards The number of independently locked shards.
+ */
+Fitness_Cache::Fitness_Cache(int capacity, int num_shards) {
+    if (capacity <= 0) {
+        return;
+    }
+    num_shards = std::max(1, std::min(num_shards, capacity));
+    int slots_per_shard = capacity / num_shards;
+
+    shards = std::vector<Shard>(num_shards);
+    for (Shard& shard : shards) {
+        shard.slots.resize(slots_per_shard);
+        shard.index.reserve(slots_per_shard);
+    }
+}
+
+
+/**
+ * Hashes an individual by mixing every gene with its position.
+ *
+ * @param vector_size The size of the individual.
+ * @param vector The individual.
+ * @return A 64-bit hash of the individual.
+ */
+std::uint64_t Fitness_Cache::hash(int vector_size, const int* vector) {
+    std::uint64_t h = 0x9E3779B97F4A7C15ull ^ static_cast<std::uint64_t>(vector_size);
+    for (int i = 0; i < vector_size; ++i) {
+        h ^= static_cast<std::uint32_t>(vector[i]);
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    }
+    // Final avalanche, so the shard bits depend on every gene
+    h ^= h >> 30;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+
+/**
+ * Looks up the fitness of an individual and marks its slot as recently used.
+ *
+ * @param vector_size The size of the individual.
+ * @param vector The individual.
+ * @param fitness Receives the cached fitness on a hit.
+ * @return True on a hit, false otherwise.
+ */
+bool Fitness_Cache::lookup(int vector_size, const int* vector, double& fitness) {
+    if (shards.empty()) {
+        return false;
+    }
+    std::uint64_t h = hash(vector_size, vector);
+    Shard& shard = shards[(h >> 32) % shards.size()];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(h);
+    if (found != shard.index.end()) {
+        Slot& slot = shard.slots[found->second];
+        if (static_cast<int>(slot.key.size()) == vector_size && std::equal(slot.key.begin(), slot.key.end(), vector)) {
+            slot.referenced = true;
+            fitness = slot.fitness;
+            ++shard.hits;
+            return true;
+        }
+    }
+    ++shard.misses;
+    return false;
+}
+
+
+/**
+ * Stores the fitness of an individual. A full shard evicts the first slot the clock hand
+ * finds without its referenced bit, clearing the bits it passes over.
+ *
+ * @param vector_size The size of the individual.
+ * @param vector The individual.
+ * @param fitness The fitness to store.
+ */
+void Fitness_Cache::insert(int vector_size, const int* vector, double fitness) {
+    if (shards.empty()) {
+        return;
+    }
+    std::uint64_t h = hash(vector_size, vector);
+    Shard& shard = shards[(h >> 32) % shards.size()];
+    int num_slots = shard.slots.size();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    int target;
+    auto found = shard.index.find(h);
+    if (found != shard.index.end()) {
+        // Same hash: refresh the slot (a different individual with the same hash replaces it)
+        target = found->second;
+    } else if (shard.used < num_slots) {
+        target = shard.used++;
+    } else {
+        while (shard.slots[shard.hand].referenced) {
+            shard.slots[shard.hand].referenced = false;
+            shard.hand = (shard.hand + 1) % num_slots;
+        }
+        target = shard.hand;
+        shard.hand = (shard.hand + 1) % num_slots;
+        shard.index.erase(shard.slots[target].key_hash);
+    }
+
+    Slot& slot = shard.slots[target];
+    slot.key_hash = h;
+    slot.key.assign(vector, vector + vector_size);
+    slot.fitness = fitness;
+    slot.referenced = false;
+    shard.index[h] = target;
+}
+
+
+/**
+ * Sums the lookup counts of all shards.
+ *
+ * @return The lookup counts since the cache was created.
+ */
+Fitness_Cache::Statistics Fitness_Cache::statistics() const {
+    Statistics total;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.hits;
+        total.misses += shard.misses;
+    }
+    return total;
+}
+
+
+/**
+ * Counts the cached individuals.
+ *
+ * @return The number of cached individuals.
+ */
+int Fitness_Cache::size() const {
+    int total = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.used;
+    }
+    return total;
+}
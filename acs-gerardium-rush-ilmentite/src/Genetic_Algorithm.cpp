@@ -11,9 +11,12 @@
 #include <cstdlib>
 #include <ctime>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <omp.h>
 #include "Genetic_Algorithm.h"
+#include "Fitness_Cache.h"
+#include "Population_Buffer.h"
 
 namespace fs = std::filesystem;
 
@@ -28,12 +31,13 @@ int number_of_units = 1;
  * 
  * @param percentage The completion percentage of the operation.
  * @param performance A floating point value indicating current performance metrics.
+ * @param cache_hit_rate The fraction of fitness lookups answered by the cache.
  */
-void printProgress(double percentage, double performance) {
+void printProgress(double percentage, double performance, double cache_hit_rate) {
     int val = (int)(percentage * 100);
     int lpad = (int)(percentage * PBWIDTH);
     int rpad = PBWIDTH - lpad;
-    printf("\r%3d%% [%.*s%*s] Item %.2f", val, lpad, PBSTR, rpad, "", performance);
+    printf("\r%3d%% [%.*s%*s] Item %.2f Cache %3d%%", val, lpad, PBSTR, rpad, "", performance, (int)(cache_hit_rate * 100));
     fflush(stdout);
 }
 
@@ -70,59 +74,81 @@ double generate_random_number(double min, double max) {
 }
 
 
+/**
+ * Draws random vectors into an individual until one passes the validity check. Genes are drawn
+ * from 0 to number_of_units - 1, skipping values that send the feed to an outlet or a stream back
+ * to its own unit, which no valid circuit has.
+ * 
+ * The chance that a random vector is valid falls quickly with its size, so this takes many draws
+ * for large circuits; a generator that builds valid individuals directly avoids that.
+ * 
+ * @param individual The first gene of the individual.
+ * @param vector_size The size of the individual.
+ * @param number_of_units One more than the largest value a gene may take.
+ * @param validity A function that checks the validity of an individual.
+ * @param gen The random number generator of the calling thread.
+ */
+static void draw_valid_individual(int* individual, int vector_size, int number_of_units,
+                                  const std::function<bool(int, int*)>& validity, std::mt19937& gen) {
+    std::uniform_int_distribution<> distr(0, number_of_units - 1);
+    do {
+        for (int j = 0; j < vector_size; ++j) {
+            individual[j] = distr(gen);
+
+            bool valid = true;
+            if (j == 0) {
+                if (individual[j] == number_of_units - 2 || individual[j] == number_of_units - 3) {
+                    valid = false;
+                }
+            } else if ((j - 1) / 3 == individual[j]) {
+                valid = false;
+            }
+
+            if (!valid) {
+                j--;
+            }
+        }
+    } while (!validity(vector_size, individual));
+}
+
+
 /**
  * Initializes a population for the genetic algorithm.
  * 
+ * The population is sized up front and every thread takes the next free slot from an atomic
+ * counter, so no lock is held and validity checks run in parallel; the validity function and the
+ * generator must therefore be safe to call from several threads. Every slot after the initial
+ * vector holds a valid individual: built by the generator if there is one, or otherwise drawn at
+ * random until it passes the validity check, which is slow for large circuits.
+ * 
  * @param population_size The size of the population to initialize.
  * @param vector_size The size of each individual in the population.
  * @param initial_vector Initial values for the first individual in the population.
  * @param validity A function that checks the validity of an individual.
  * @param elitism_rate The rate of elitism to apply during evolution.
+ * @param generator Builds a valid individual, if set, in place of random vectors.
  * @return A vector of vectors containing the initialized population.
  */
-std::vector<std::vector<int>> initialize_population(int population_size, int vector_size, const int* initial_vector, std::function<bool(int, int*)> validity, double elitism_rate) {
-    std::vector<std::vector<int>> population;
-    population.reserve(population_size);  // Reserve space to avoid reallocations
-
+std::vector<std::vector<int>> initialize_population(int population_size, int vector_size, const int* initial_vector, std::function<bool(int, int*)> validity, double elitism_rate,
+                                                    std::function<bool(int, int*, std::mt19937&)> generator) {
     std::vector<int> start_vector(initial_vector, initial_vector + vector_size);
-    population.push_back(start_vector);
+    std::vector<std::vector<int>> population(std::max(population_size, 1), start_vector);
 
     number_of_units = *std::max_element(initial_vector, initial_vector + vector_size) + 1;
 
+    std::atomic<int> next_slot(1);
     #pragma omp parallel
     {
         std::random_device rd;
         std::mt19937 gen(rd() + omp_get_thread_num());  // Unique seed for each thread
-        std::uniform_int_distribution<> distr(0, number_of_units - 1);
-
-        #pragma omp for
-        for (int i = 1; i < population_size; ++i) {
-            std::vector<int> individual(vector_size);
-            for (int j = 0; j < vector_size; ++j) {
-                individual[j] = distr(gen);
-
-                bool valid = true;
-                if (j == 0) {
-                    if (individual[j] == number_of_units - 2 || individual[j] == number_of_units - 3) {
-                        valid = false;
-                    }
-                } else if ((j - 1) / 3 == individual[j]) {
-                    valid = false;
-                }
 
-                if (!valid) {
-                    j--;
-                }
+        for (int i = next_slot++; i < population_size; i = next_slot++) {
+            std::vector<int>& individual = population[i];
+            if (generator && generator(vector_size, individual.data(), gen)) {
+                continue;
             }
 
-            #pragma omp critical
-            {
-                if (validity(vector_size, individual.data()) || population.size() < population_size * 0.8) {
-                    population.push_back(individual);
-                } else {
-                    --i;  // Retry this iteration
-                }
-            }
+            draw_valid_individual(individual.data(), vector_size, number_of_units, validity, gen);
         }
     }
 
@@ -169,8 +195,24 @@ std::vector<std::vector<int>> select(const std::vector<std::vector<int>>& popula
  * @param maxGenerations The maximum number of generations expected to run.
  */
 void NonUniform_Mutation(std::vector<int>& individual, double mutation_rate, int max_value, int currentGeneration, int maxGenerations) {
+    NonUniform_Mutation(individual.data(), individual.size(), mutation_rate, max_value, currentGeneration, maxGenerations);
+}
+
 
-    for (int& gene : individual) {
+/**
+ * Applies a non-uniform mutation to an individual stored in place, such as one in a Population_Buffer.
+ * 
+ * @param individual The first gene of the individual to mutate.
+ * @param vector_size The number of genes of the individual.
+ * @param mutation_rate The mutation rate to apply.
+ * @param max_value The maximum value for any gene in the individual.
+ * @param currentGeneration The current generation number in the genetic algorithm.
+ * @param maxGenerations The maximum number of generations expected to run.
+ */
+void NonUniform_Mutation(int* individual, int vector_size, double mutation_rate, int max_value, int currentGeneration, int maxGenerations) {
+
+    for (int i = 0; i < vector_size; ++i) {
+        int& gene = individual[i];
         if (generate_random_number(0.0, 1.0) < mutation_rate) {
             double delta = (generate_random_number(0.0, 1.0) < 0.5) ? gene : max_value - gene;
             double b = 5;
@@ -195,8 +237,22 @@ void NonUniform_Mutation(std::vector<int>& individual, double mutation_rate, int
  * @param max_unit The maximum value any element in the vector can take.
  */
 void mutate_vector(std::vector<int>& vector, double mutation_rate, int max_unit) {
+    mutate_vector(vector.data(), vector.size(), mutation_rate, max_unit);
+}
+
+
+/**
+ * Mutates a vector stored in place, such as an individual in a Population_Buffer.
+ * 
+ * @param vector The first element of the vector to mutate.
+ * @param vector_size The number of elements of the vector.
+ * @param mutation_rate The probability of mutating each element of the vector.
+ * @param max_unit The maximum value any element in the vector can take.
+ */
+void mutate_vector(int* vector, int vector_size, double mutation_rate, int max_unit) {
     
-    for (int& value : vector) {
+    for (int i = 0; i < vector_size; ++i) {
+        int& value = vector[i];
         if (generate_random_number(0.0, 1.0) < mutation_rate) {
             value = (value + static_cast<int>(generate_random_number(0, max_unit))) % (max_unit + 1);
         }
@@ -213,12 +269,26 @@ void mutate_vector(std::vector<int>& vector, double mutation_rate, int max_unit)
  * @param max_value The maximum value for any gene in the vectors.
  */
 void crossover(std::vector<int>& parent1, std::vector<int>& parent2, double crossover_rate, int max_value) {
+    crossover(parent1.data(), parent2.data(), parent1.size(), crossover_rate, max_value);
+}
+
+
+/**
+ * Performs a single-point crossover between two parents stored in place, such as individuals in a
+ * Population_Buffer.
+ * 
+ * @param parent1 The first gene of the first parent.
+ * @param parent2 The first gene of the second parent.
+ * @param vector_size The number of genes of each parent.
+ * @param crossover_rate The probability of performing a crossover.
+ * @param max_value The maximum value for any gene in the vectors.
+ */
+void crossover(int* parent1, int* parent2, int vector_size, double crossover_rate, int max_value) {
 
     if (generate_random_number(0.0, 1.0) < crossover_rate) {
-        std::uniform_int_distribution<> point_dist(1, parent1.size() - 2);
-        int crossover_point = static_cast<int>(generate_random_number(1, parent1.size() - 2));
+        int crossover_point = static_cast<int>(generate_random_number(1, vector_size - 2));
 
-        for (int i = crossover_point; i < parent1.size(); ++i) {
+        for (int i = crossover_point; i < vector_size; ++i) {
             std::swap(parent1[i], parent2[i]);
         }
     }
@@ -228,12 +298,16 @@ void crossover(std::vector<int>& parent1, std::vector<int>& parent2, double cros
 /**
  * Selects an index for roulette wheel selection based on cumulative fitness scores.
  * 
+ * Negative fitness values leave the sums out of order, so the choice may fall past the last
+ * individual; it is then kept to the last one.
+ * 
  * @param cumulative_fitness A vector of cumulative fitness scores.
  * @return The selected index based on the random choice in the cumulative distribution.
  */
 int select_index(const std::vector<double>& cumulative_fitness) {
     double rnd = generate_random_number(0.0, cumulative_fitness.back());
-    return std::lower_bound(cumulative_fitness.begin(), cumulative_fitness.end(), rnd) - cumulative_fitness.begin();
+    int index = std::lower_bound(cumulative_fitness.begin(), cumulative_fitness.end(), rnd) - cumulative_fitness.begin();
+    return std::min(index, (int) cumulative_fitness.size() - 1);
 }
 
 
@@ -241,20 +315,88 @@ int select_index(const std::vector<double>& cumulative_fitness) {
  * Regenerates the population by introducing new random vectors to replace the less fit individuals,
  * aiming to introduce diversity and prevent premature convergence.
  * 
- * @param population The population of vectors.
- * @param vector_size The size of each vector.
- * @param number_of_units The maximum value for any gene in the vectors.
+ * Every replacement is valid: built by the generator if there is one, or otherwise drawn at random
+ * until it passes the validity check.
+ * 
+ * @param population The current generation of the population buffer.
+ * @param number_of_units One more than the largest value a gene may take.
+ * @param validity A function that checks the validity of an individual.
+ * @param generator Builds a valid individual, if set, in place of a random vector.
  */
-void regenerate_population(std::vector<std::vector<int>>& population, int vector_size, int number_of_units) {
+void regenerate_population(Population_Buffer& population, int number_of_units,
+                           const std::function<bool(int, int*)>& validity,
+                           const std::function<bool(int, int*, std::mt19937&)>& generator) {
+    int vector_size = population.vector_size();
     #pragma omp parallel for
     for (int i = (int) (population.size() * 0.2); i < population.size(); ++i) {  // Start from 1 to keep the first vector unchanged
         std::random_device rd;
         std::mt19937 gen(rd() + omp_get_thread_num()); // Ensuring unique seed per thread
-        std::uniform_int_distribution<> distr(0, number_of_units - 1);
 
-        for (int j = 0; j < vector_size; ++j) {
-            population[i][j] = distr(gen);
+        int* individual = population.individual(i);
+        if (generator && generator(vector_size, individual, gen)) {
+            continue;
         }
+        draw_valid_individual(individual, vector_size, number_of_units, validity, gen);
+    }
+}
+
+
+/**
+ * Breeds the next generation of a population buffer from its current one.
+ * 
+ * The elites are copied unchanged into the first slots. Each remaining pair of slots then gets two
+ * children of parents picked by roulette wheel selection, crossed over and mutated in place; the
+ * pairs are bred in parallel and the random numbers come from the generator of each thread. With
+ * an odd number of slots left, the second child of the last pair is bred in scratch space and
+ * dropped.
+ * 
+ * @param buffer The population; its current generation is read and its next generation filled.
+ * @param ranking The indices of the current generation, best first.
+ * @param elitism_count The number of elites carried over.
+ * @param cumulative_fitness The cumulative fitness of the current generation, for selection.
+ * @param parameters The crossover and non-uniform mutation rates and the number of iterations.
+ * @param mutation_rate The rate of the uniform mutation, raised while the fitness stagnates.
+ * @param generation The current generation number.
+ * @param number_of_units One more than the largest value a gene may take.
+ */
+void breed_generation(Population_Buffer& buffer, const std::vector<int>& ranking, int elitism_count,
+                      const std::vector<double>& cumulative_fitness, const Algorithm_Parameters& parameters,
+                      double mutation_rate, int generation, int number_of_units) {
+    int population_size = buffer.size();
+    int vector_size = buffer.vector_size();
+    int max_value = number_of_units - 1;
+
+    // Implement elitism, save the best individuals
+    for (int i = 0; i < elitism_count; ++i) {
+        std::copy(buffer.individual(ranking[i]), buffer.individual(ranking[i]) + vector_size, buffer.next(i));
+    }
+
+    int pair_count = (population_size - elitism_count + 1) / 2;
+    #pragma omp parallel for schedule(static)
+    for (int pair = 0; pair < pair_count; ++pair) {
+        static thread_local std::vector<int> spare_child;
+        spare_child.resize(vector_size);
+        int slot = elitism_count + 2 * pair;
+        int* parent1 = buffer.next(slot);
+        int* parent2 = slot + 1 < population_size ? buffer.next(slot + 1) : spare_child.data();
+        const int* selected1 = buffer.individual(select_index(cumulative_fitness));
+        const int* selected2 = buffer.individual(select_index(cumulative_fitness));
+        std::copy(selected1, selected1 + vector_size, parent1);
+        std::copy(selected2, selected2 + vector_size, parent2);
+
+        crossover(parent1, parent2, vector_size, parameters.crossover_rate, max_value);
+        crossover(parent1, parent2, vector_size, parameters.crossover_rate, max_value);
+
+        // if (vector_size > 100) {
+        //     while (!validity(vector_size, parent1) && !validity(vector_size, parent2)) {
+        //         crossover(parent1, parent2, vector_size, parameters.crossover_rate, max_value);
+        //     }
+        // }
+
+        NonUniform_Mutation(parent1, vector_size, parameters.mutation_rate, max_value, generation, parameters.max_iterations);
+        NonUniform_Mutation(parent2, vector_size, parameters.mutation_rate, max_value, generation, parameters.max_iterations);
+        mutate_vector(parent1, vector_size, mutation_rate, max_value);
+        mutate_vector(parent2, vector_size, mutation_rate, max_value);
     }
 }
 
@@ -262,16 +404,26 @@ void regenerate_population(std::vector<std::vector<int>>& population, int vector
 /**
  * Conducts the entire genetic algorithm process, managing the population through multiple generations
  * and applying genetic operations like selection, crossover, and mutation to evolve solutions.
+ *
+ * From the second generation on, the fitness function is given the fitness of the weakest elite
+ * of the previous generation. The elites are carried over, so an individual that cannot beat it
+ * will not become an elite and its evaluation may stop early with an estimate below it.
+ *
+ * The generations live in a Population_Buffer, copied from the population on entry and back into
+ * it on return, so no memory is allocated between generations. Fitness evaluation and breeding
+ * both run in parallel; the children are written straight into the next generation of the buffer,
+ * which then swaps places with the current one.
  * 
- * @param population The initial population of solutions.
- * @param func A function pointer to the fitness evaluation function.
+ * @param population The initial population of solutions, replaced by the final one.
+ * @param func The fitness evaluation function, taking the size, the individual and the elite cutoff.
  * @param validity A function to check the validity of individual solutions.
  * @param parameters Struct containing parameters for the genetic algorithm.
  * @return The maximum fitness achieved by the best solution in the population.
  */
-double genetic_algorithm(std::vector<std::vector<int>>& population, double (&func) (int, int*),
-                         std::function<bool(int, int*)> validity,
-                         const Algorithm_Parameters& parameters) {
+double genetic_algorithm_bounded(std::vector<std::vector<int>>& population,
+                                 std::function<double(int, int*, double)> func,
+                                 std::function<bool(int, int*)> validity,
+                                 const Algorithm_Parameters& parameters) {
     int population_size = population.size();
     int vector_size = population[0].size();
     std::vector<double> fitness(population_size);
@@ -279,69 +431,65 @@ double genetic_algorithm(std::vector<std::vector<int>>& population, double (&fun
     int fitness_unchanged_count = 0;
 
     int elitism_count = static_cast<int>(population.size() * parameters.elitism_rate);
+    Population_Buffer buffer(population);
+    std::vector<int> idx(population_size);
+    std::vector<double> cumulative_fitness(population_size);
+
+    Fitness_Cache cache(parameters.fitness_cache_capacity);
+    Fitness_Cache::Statistics previous_statistics;
+    // Fitness an individual needs to become an elite; nothing is cut off in the first generation
+    double elite_cutoff = -std::numeric_limits<double>::infinity();
 
     for (int generation = 0; generation < parameters.max_iterations; ++generation) {
-        // Evaluate fitness for each vector in the population
+        // Evaluate fitness for each vector in the population, unless the cache knows it
         #pragma omp parallel for
         for (int i = 0; i < population_size; ++i) {
-            if (validity(vector_size, population[i].data())) {
-                fitness[i] = func(vector_size, population[i].data());
+            int* individual = buffer.individual(i);
+            if (cache.lookup(vector_size, individual, fitness[i])) {
+                continue;
+            }
+            if (validity(vector_size, individual)) {
+                fitness[i] = func(vector_size, individual, elite_cutoff);
             } else {
                 fitness[i] = std::numeric_limits<double>::lowest();
             }
+            cache.insert(vector_size, individual, fitness[i]);
+        }
+
+        // Hit rate of this generation
+        Fitness_Cache::Statistics statistics = cache.statistics();
+        Fitness_Cache::Statistics generation_statistics;
+        generation_statistics.hits = statistics.hits - previous_statistics.hits;
+        generation_statistics.misses = statistics.misses - previous_statistics.misses;
+        previous_statistics = statistics;
+
+        if (parameters.generation_callback) {
+            parameters.generation_callback(generation);
         }
 
         // Sort the population based on fitness
-        std::vector<int> idx(population_size);
         std::iota(idx.begin(), idx.end(), 0);
         std::sort(idx.begin(), idx.end(), [&](int i1, int i2) { return fitness[i1] > fitness[i2]; });
 
-        printProgress((double)generation / (parameters.max_iterations - 1), fitness[idx[0]]);
-
-        // Implement elitism, save the best individuals
-        std::vector<std::vector<int>> new_population;
-        for (int i = 0; i < elitism_count; ++i) {
-            new_population.push_back(population[idx[i]]);
+        printProgress((double)generation / (parameters.max_iterations - 1), fitness[idx[0]], generation_statistics.hit_rate());
+        if (elitism_count > 0 && fitness[idx[elitism_count - 1]] > std::numeric_limits<double>::lowest()) {
+            elite_cutoff = fitness[idx[elitism_count - 1]];
         }
 
         // Create a cumulative fitness sum for roulette wheel selection
-        std::vector<double> cumulative_fitness(population_size);
         std::partial_sum(fitness.begin(), fitness.end(), cumulative_fitness.begin());
 
-        // #pragma omp parallel for
-        for (int i = elitism_count; i < population.size(); i+=2) {
-            std::vector<int> parent1 = population[select_index(cumulative_fitness)];
-            std::vector<int> parent2 = population[select_index(cumulative_fitness)];
-
-            crossover(parent1, parent2, parameters.crossover_rate, number_of_units);
-            crossover(parent1, parent2, parameters.crossover_rate, number_of_units);
-
-            // if (vector_size > 100) {
-            //     while (!validity(vector_size, parent1.data()) && !validity(vector_size, parent2.data())) {
-            //         crossover(parent1, parent2, parameters.crossover_rate, number_of_units);
-            //     }
-            // }
-
-            NonUniform_Mutation(parent1, parameters.mutation_rate, number_of_units, generation, parameters.max_iterations);
-            NonUniform_Mutation(parent2, parameters.mutation_rate, number_of_units, generation, parameters.max_iterations);
-            double mutator = 0.0;
-
-            if (fitness_unchanged_count > (parameters.max_iterations * 0.1)) {
-                mutator = parameters.mutation_rate + (fitness_unchanged_count * 0.001);
-                mutator = mutator < 0.5 ? mutator : 0.5;
-            } else {
-
-                mutator = parameters.mutation_rate;
-            }
-            mutate_vector(parent1, mutator, number_of_units);
-            mutate_vector(parent2, mutator, number_of_units);
+        double mutator = 0.0;
+        if (fitness_unchanged_count > (parameters.max_iterations * 0.1)) {
+            mutator = parameters.mutation_rate + (fitness_unchanged_count * 0.001);
+            mutator = mutator < 0.5 ? mutator : 0.5;
+        } else {
 
-            new_population.push_back(parent1);
-            if (new_population.size() < population_size) {
-                new_population.push_back(parent2);
-            }
+            mutator = parameters.mutation_rate;
         }
 
+        breed_generation(buffer, idx, elitism_count, cumulative_fitness, parameters, mutator, generation, number_of_units);
+
         double temp_fitness = find_max_double(fitness.data(), fitness.size());
         if (temp_fitness - max_fitness < 0.1) {
             fitness_unchanged_count++;
@@ -357,40 +505,59 @@ double genetic_algorithm(std::vector<std::vector<int>>& population, double (&fun
           std::ofstream vector_file("./output/vector.dat");
           if (vector_file.is_open()) {
               for (int i = 0; i < vector_size; i++) {
-                  vector_file << population[0][i] << " ";
+                  vector_file << buffer.individual(0)[i] << " ";
               }
               vector_file.close();
           }
 
         }
-        population = new_population;
+        buffer.swap();
         if (fitness_unchanged_count > 50) {
-            regenerate_population(population, vector_size, number_of_units);
+            regenerate_population(buffer, number_of_units, validity, parameters.generator);
             fitness_unchanged_count = 0;
         }
         #pragma omp barrier
         max_fitness = *std::max_element(fitness.begin(), fitness.end());
     }
+    buffer.store(population);
     std::cout << std::endl;
     return max_fitness;
 }
 
 
+/**
+ * Runs genetic_algorithm_bounded with a fitness function that always evaluates in full.
+ * 
+ * @param population The initial population of solutions.
+ * @param func The fitness evaluation function, such as Evaluate_Circuit or a Circuit_Evaluator.
+ * @param validity A function to check the validity of individual solutions.
+ * @param parameters Struct containing parameters for the genetic algorithm.
+ * @return The maximum fitness achieved by the best solution in the population.
+ */
+double genetic_algorithm(std::vector<std::vector<int>>& population, std::function<double(int, int*)> func,
+                         std::function<bool(int, int*)> validity,
+                         const Algorithm_Parameters& parameters) {
+    auto unbounded = [func](int vector_size, int *vector, double) { return func(vector_size, vector); };
+    return genetic_algorithm_bounded(population, unbounded, validity, parameters);
+}
+
+
 /**
  * Optimizes a vector using genetic algorithm principles. Initializes a population, runs the genetic algorithm,
- * and stores the best solution back into the original vector.
+ * and stores the best solution back into the original vector. The fitness function is given the
+ * elite cutoff, as in genetic_algorithm_bounded.
  * 
  * @param vector_size The size of the vector to be optimized.
  * @param vector The vector containing initial values, modified in-place to store the best solution found.
- * @param func A function pointer to the fitness evaluation function.
+ * @param func The fitness evaluation function, taking the size, the individual and the elite cutoff.
  * @param validity A function to check the validity of individual solutions.
  * @param parameters Struct containing parameters for the genetic algorithm.
  * @return Returns 0 on successful execution and optimization, -1 if file operation fails.
  */
-int optimize(int vector_size, int *vector,
-             double (&func) (int, int*),
-             std::function<bool(int, int*)> validity,
-             struct Algorithm_Parameters parameters) {
+int optimize_bounded(int vector_size, int *vector,
+                     std::function<double(int, int*, double)> func,
+                     std::function<bool(int, int*)> validity,
+                     struct Algorithm_Parameters parameters) {
     // print the number of threads
     std::cout << "Number of threads: " << omp_get_max_threads() << std::endl;
 
@@ -403,8 +570,9 @@ int optimize(int vector_size, int *vector,
         vector[i] = 0;
     }
 
-    std::vector<std::vector<int>> population = initialize_population(parameters.initial_pop, vector_size, vector, validity, parameters.elitism_rate);
-    double max_fitness = genetic_algorithm(population, func, validity, parameters);
+    std::vector<std::vector<int>> population = initialize_population(parameters.initial_pop, vector_size, vector, validity, parameters.elitism_rate,
+                                                                             parameters.generator);
+    double max_fitness = genetic_algorithm_bounded(population, func, validity, parameters);
     std::copy(population[0].begin(), population[0].end(), vector);
 
     std::ofstream vector_file("./output/vector.dat");
@@ -419,3 +587,22 @@ int optimize(int vector_size, int *vector,
 
     return 0;
 }
+
+
+/**
+ * Runs optimize_bounded with a fitness function that always evaluates in full.
+ * 
+ * @param vector_size The size of the vector to be optimized.
+ * @param vector The vector containing initial values, modified in-place to store the best solution found.
+ * @param func The fitness evaluation function, such as Evaluate_Circuit or a Circuit_Evaluator.
+ * @param validity A function to check the validity of individual solutions.
+ * @param parameters Struct containing parameters for the genetic algorithm.
+ * @return Returns 0 on successful execution and optimization, -1 if file operation fails.
+ */
+int optimize(int vector_size, int *vector,
+             std::function<double(int, int*)> func,
+             std::function<bool(int, int*)> validity,
+             struct Algorithm_Parameters parameters) {
+    auto unbounded = [func](int vector_size, int *vector, double) { return func(vector_size, vector); };
+    return optimize_bounded(vector_size, vector, unbounded, validity, parameters);
+}
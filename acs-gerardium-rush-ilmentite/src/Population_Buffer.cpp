@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <cstdint>
+#include "Population_Buffer.h"
+
+
+/**
+ * Creates a buffer for two generations. The stride is the vector size rounded up to whole cache
+ * lines, and the block starts at the first aligned int of the storage.
+ *
+ * @param population_size The number of individuals in a generation.
+ * @param vector_size The number of genes of an individual.
+ */
+Population_Buffer::Population_Buffer(int population_size, int vector_size)
+    : population_size(population_size), genes(vector_size) {
+    const int line = alignment / static_cast<int>(sizeof(int));
+    row = (vector_size + line - 1) / line * line;
+    long generation = static_cast<long>(population_size) * row;
+    storage.assign(2 * generation + line, 0);
+
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(storage.data());
+    std::uintptr_t misalignment = address % alignment;
+    current = storage.data() + (misalignment == 0 ? 0 : (alignment - misalignment) / sizeof(int));
+    following = current + generation;
+}
+
+
+/**
+ * Creates a buffer sized for the population and copies it into the current generation.
+ *
+ * @param population The population; every individual has the size of the first one.
+ */
+Population_Buffer::Population_Buffer(const std::vector<std::vector<int>> &population)
+    : Population_Buffer(population.size(), population.empty() ? 0 : population[0].size()) {
+    for (int i = 0; i < population_size; ++i) {
+        std::copy(population[i].begin(), population[i].begin() + genes, individual(i));
+    }
+}
+
+
+/**
+ * Copies the current generation out, reusing the vectors already in the population.
+ *
+ * @param population Receives the individuals, resized to fit.
+ */
+void Population_Buffer::store(std::vector<std::vector<int>> &population) const {
+    population.resize(population_size);
+    for (int i = 0; i < population_size; ++i) {
+        population[i].assign(individual(i), individual(i) + genes);
+    }
+}
@@ -1,8 +1,11 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <vector>
 #include "CUnit.h"
 #include "CCircuit.h"
 #include "CSimulator.h"
+#include "Circuit_Evaluator.h"
 #include "Genetic_Algorithm.h"
 
 using namespace std;
@@ -17,19 +20,96 @@ int main(int argc, char *argv[]) {
     // Adjust the parameters as needed
     Algorithm_Parameters params = {1000, 0.9, 0.01, 0.1, 500};
 
+    // The plant and solver come from --config=file and --section.name=value flags
+    Circuit_Parameters circuit_parameters;
+    std::vector<string> arguments;
+    string error;
+    if (!Parse_Circuit_Arguments(argc, argv, circuit_parameters, arguments, error)) {
+        cerr << error << endl;
+        return 1;
+    }
+    Circuit_Evaluator evaluator(circuit_parameters);
+
+    // Every --scenario=file is read over the parameters above; with scenarios, circuits are
+    // scored by their worst (or, with --aggregate=mean, mean) performance over them
+    std::vector<Circuit_Parameters> scenarios;
+    Scenario_Aggregate aggregate = Scenario_Aggregate::worst;
+    // With --abort-below-elite, simulations predicted to miss the elite cutoff stop early; the
+    // prediction is a guess from the convergence rate, so it is off unless asked for
+    bool abort_below_elite = false;
+
+    // Collect the simulation counters of every generation; --residuals also samples the
+    // convergence curve, at the cost of a few extra passes per simulation
+    for (const string &argument : arguments) {
+        if (argument == "--residuals") {
+            Simulation_Statistics::sample_residuals(true);
+        } else if (argument.rfind("--scenario=", 0) == 0) {
+            scenarios.push_back(circuit_parameters);
+            if (!Read_Circuit_Config(argument.substr(11), scenarios.back(), error)) {
+                cerr << error << endl;
+                return 1;
+            }
+        } else if (argument == "--aggregate=worst" || argument == "--aggregate=mean") {
+            aggregate = argument == "--aggregate=worst" ? Scenario_Aggregate::worst : Scenario_Aggregate::mean;
+        } else if (argument == "--abort-below-elite") {
+            abort_below_elite = true;
+        } else {
+            cerr << "Unknown argument " << argument << endl;
+            return 1;
+        }
+    }
+    if (abort_below_elite && !scenarios.empty()) {
+        cerr << "--abort-below-elite cannot be combined with --scenario" << endl;
+        return 1;
+    }
+    // Start from circuits that are valid by construction rather than rejection sampling
+    params.generator = Random_Valid_Circuit;
+    std::vector<Simulation_Statistics> generation_statistics;
+    params.generation_callback = [&generation_statistics](int) {
+        generation_statistics.push_back(Collect_Simulation_Statistics());
+    };
 
     // Measure time for optimize function
+    Collect_Validity_Statistics();
     auto start_optimize = chrono::high_resolution_clock::now();
-    optimize(n, vector, Evaluate_Circuit, Check_Validity, params);
+    if (abort_below_elite) {
+        optimize_bounded(n, vector, evaluator, Check_Validity, params);
+    } else if (scenarios.empty()) {
+        optimize(n, vector, evaluator, Check_Validity, params);
+    } else {
+        optimize(n, vector, Scenario_Evaluator(scenarios, aggregate), Check_Validity, params);
+    }
     auto end_optimize = chrono::high_resolution_clock::now();
     chrono::duration<double> duration_optimize = end_optimize - start_optimize;
     cout << "Time taken for optimization: " << duration_optimize.count() << " seconds" << endl;
 
-    // Measure time for Evaluate_Circuit function
-    double evaluation_result = Evaluate_Circuit(n, vector);
+    // How many candidates the structural pre-filter turned away before the full validity check
+    Validity_Statistics validity_statistics = Collect_Validity_Statistics();
+    cout << "Validity checks: " << validity_statistics.checks << ", valid " << validity_statistics.valid
+         << ", rejected by the pre-filter " << validity_statistics.rejected()
+         << " (feed " << validity_statistics.bad_feed << ", self-recycle " << validity_statistics.self_recycle
+         << ", outlet " << validity_statistics.misrouted << "), saving about "
+         << validity_statistics.seconds_saved() << " seconds" << endl;
+
+    if (!Write_Simulation_Statistics(generation_statistics, "./output/convergence.csv")) {
+        cerr << "Could not write ./output/convergence.csv" << endl;
+    }
+
+    // Evaluate the best circuit once and write its performance, recovery and grade
+    Evaluation_Result evaluation_result = evaluator.simulate(n, vector);
+    if (!Write_Performance(evaluation_result, "./output/performance.dat")) {
+        cerr << "Could not write ./output/performance.dat" << endl;
+    }
 
     // Generate final output, save to file, etc.
-    cout << "Evaluation result: " << evaluation_result << endl;
+    cout << "Evaluation result: " << evaluation_result.performance << endl;
+    if (!scenarios.empty()) {
+        std::vector<Evaluation_Result> scenario_results;
+        Simulate_Circuit_Scenarios(n, vector, scenarios, scenario_results);
+        for (size_t s = 0; s < scenario_results.size(); s++) {
+            cout << "Scenario " << s + 1 << " result: " << scenario_results[s].performance << endl;
+        }
+    }
 
     return 0;
 }
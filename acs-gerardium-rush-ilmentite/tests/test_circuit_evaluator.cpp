@@ -0,0 +1,230 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include "CSimulator.h"
+#include "Circuit_Evaluator.h"
+
+
+void test_default_evaluator() {
+    int five_units[16] = {0, 1, 3, 2, 4, 4, 3, 1, 3, 6, 1, 1, 0, 5, 1, 1};
+    int ten_units[31] = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    Circuit_Evaluator evaluator;
+
+    assert(evaluator(16, five_units) == Evaluate_Circuit(16, five_units));
+    assert(evaluator(31, ten_units) == Evaluate_Circuit(31, ten_units));
+    assert(evaluator.simulate(31, ten_units).iterations == Simulate_Circuit(31, ten_units).iterations);
+
+    // The evaluator is a plain objective for the genetic algorithm
+    std::function<double(int, int *)> objective = evaluator;
+    std::function<double(int, int *, double)> bounded_objective = evaluator;
+    assert(objective(16, five_units) == evaluator(16, five_units));
+    assert(bounded_objective(16, five_units, -1.0e300) == evaluator(16, five_units));
+    std::cout << "Default evaluator test passed." << std::endl;
+}
+
+
+void test_set_parameter() {
+    Circuit_Parameters parameters;
+    std::string error;
+
+    assert(Set_Circuit_Parameter(parameters, "economics.price", "250", error) && parameters.eco.price == 250.0);
+    assert(Set_Circuit_Parameter(parameters, "solver.max_iterations", "400", error) && parameters.max_iterations == 400);
+    assert(Set_Circuit_Parameter(parameters, "solver.method", "anderson", error) && parameters.solver == Solver_Mode::anderson);
+    assert(Set_Circuit_Parameter(parameters, "solver.parallel_units", "true", error) && parameters.parallel_units);
+
+    // A bad value leaves the parameter unchanged
+    assert(!Set_Circuit_Parameter(parameters, "solver.max_iterations", "4x", error));
+    assert(parameters.max_iterations == 400 && error.find("solver.max_iterations") != std::string::npos);
+    assert(!Set_Circuit_Parameter(parameters, "constants.rho", "dense", error) && parameters.constants.rho == 3000.0);
+    assert(!Set_Circuit_Parameter(parameters, "economics.bonus", "1", error));
+    assert(error.find("unknown") != std::string::npos);
+    std::cout << "Set parameter test passed." << std::endl;
+}
+
+
+void test_config_and_arguments() {
+    const char *filename = "test_circuit_evaluator.ini";
+    std::ofstream file(filename);
+    file << "# A cheaper ore and a looser tolerance\n"
+         << "[economics]\n"
+         << "price = 80\n"
+         << "\n"
+         << "[solver]\n"
+         << "  tolerance = 1e-5  \n"
+         << "; slower kinetics\n"
+         << "[constants]\n"
+         << "k_concentrate_gerardium = 0.003\n";
+    file.close();
+
+    Circuit_Parameters parameters;
+    std::string error;
+    assert(Read_Circuit_Config(filename, parameters, error));
+    assert(parameters.eco.price == 80.0 && parameters.tolerance == 1e-5);
+    assert(parameters.constants.k_concentrate_gerardium == 0.003 && parameters.eco.penalty == -750);
+
+    // Flags apply in order, so the one after --config overrides the file
+    std::string config_flag = std::string("--config=") + filename;
+    const char *argv[] = {"Circuit_Optimizer", "--economics.price=120", config_flag.c_str(),
+                          "--residuals", "--feed.init_Fg=12", "--economics.price=90"};
+    Circuit_Parameters flagged;
+    std::vector<std::string> remaining;
+    assert(Parse_Circuit_Arguments(6, const_cast<char **>(argv), flagged, remaining, error));
+    assert(flagged.eco.price == 90.0 && flagged.tolerance == 1e-5 && flagged.feed.init_Fg == 12.0);
+    assert(remaining.size() == 1 && remaining[0] == "--residuals");
+
+    const char *bad_argv[] = {"Circuit_Optimizer", "--solver.method=newton"};
+    assert(!Parse_Circuit_Arguments(2, const_cast<char **>(bad_argv), flagged, remaining, error));
+
+    std::ofstream broken(filename);
+    broken << "[solver]\nmax_iterations 10\n";
+    broken.close();
+    assert(!Read_Circuit_Config(filename, parameters, error));
+    assert(error.find(std::string(filename) + ":2") == 0);
+    std::remove(filename);
+
+    assert(!Read_Circuit_Config("missing_circuit_evaluator.ini", parameters, error));
+    std::cout << "Config and arguments test passed." << std::endl;
+}
+
+
+void test_parameters_reach_the_simulation() {
+    int ten_units[31] = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    int five_units[16] = {0, 1, 3, 2, 4, 4, 3, 1, 3, 6, 1, 1, 0, 5, 1, 1};
+    Circuit_Evaluator baseline;
+    Evaluation_Result base = baseline.simulate(31, ten_units);
+
+    // Only the score changes with the price: performance = cg * price + cw * penalty
+    Circuit_Parameters pricier;
+    pricier.eco.price = 200.0;
+    Evaluation_Result priced = Circuit_Evaluator(pricier).simulate(31, ten_units);
+    double concentrate_gerardium = base.recovery * pricier.feed.init_Fg;
+    assert(priced.iterations == base.iterations);
+    assert(std::fabs(priced.performance - base.performance - 100.0 * concentrate_gerardium) < 1e-9 * std::fabs(priced.performance));
+
+    // The tolerance is the convergence test
+    Circuit_Parameters loose;
+    loose.tolerance = 1e-3;
+    Evaluation_Result loose_result = Circuit_Evaluator(loose).simulate(31, ten_units);
+    assert(loose_result.converged && loose_result.iterations < base.iterations && loose_result.residual <= 1e-3);
+
+    // New kinetics give the same result in the fixed-size, dynamic and batch simulators
+    Circuit_Parameters slower;
+    slower.constants.k_concentrate_gerardium = 0.003;
+    Evaluation_Result fixed = Circuit_Evaluator(slower).simulate(31, ten_units);
+    SimulationWorkspace workspace;
+    Evaluation_Result dynamic = workspace.simulate(31, ten_units, slower);
+    Evaluation_Result batched;
+    Simulate_Circuits_Batch(31, 1, ten_units, &batched, slower);
+    assert(fixed.performance != base.performance);
+    assert(std::fabs(fixed.performance - dynamic.performance) < 1e-9 * std::fabs(fixed.performance));
+    assert(std::fabs(fixed.performance - batched.performance) < 1e-9 * std::fabs(fixed.performance));
+
+    // Settings the vectorised lanes do not support send the batch through the per-circuit path
+    Circuit_Parameters approximate;
+    approximate.recovery_table_error = 1e-4;
+    approximate.single_precision_until = 1e-3;
+    approximate.parallel_units = true;
+    Evaluation_Result approximate_batched;
+    Simulate_Circuits_Batch(31, 1, ten_units, &approximate_batched, approximate);
+    Evaluation_Result approximate_single = Simulate_Circuit(31, ten_units, approximate);
+    assert(approximate_batched.performance == approximate_single.performance);
+    assert(approximate_batched.iterations == approximate_single.iterations);
+
+    // Going back to the defaults in the same threads gives the original results
+    assert(baseline(31, ten_units) == base.performance);
+    assert(workspace.simulate(16, five_units).performance == Evaluate_Circuit(16, five_units));
+    std::cout << "Parameters reach the simulation test passed." << std::endl;
+}
+
+
+/**
+ * @brief Builds scenarios that vary the feed grade, the kinetics and the price.
+ *
+ * @return The scenarios, the first one the default plant.
+ */
+std::vector<Circuit_Parameters> make_scenarios() {
+    std::vector<Circuit_Parameters> scenarios(5);
+    scenarios[1].feed.init_Fg = 8.0;
+    scenarios[1].feed.init_Fw = 92.0;
+    scenarios[2].constants.k_concentrate_gerardium = 0.0035;
+    scenarios[2].constants.k_inter_waste = 0.0004;
+    scenarios[3].eco.price = 140.0;
+    scenarios[3].eco.penalty = -600.0;
+    scenarios[4].constants.V = 12.0;
+    scenarios[4].feed.init_Fg = 12.0;
+    return scenarios;
+}
+
+
+void test_scenarios_match_separate_runs() {
+    std::vector<std::vector<int>> circuits = {
+        {0, 1, 3, 2, 4, 4, 3, 1, 3, 6, 1, 1, 0, 5, 1, 1},
+        {0, 1, 1, 2, 3, 0, 1, 1, 1, 1},
+        {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2},
+        {0, 4, 1, 8, 12, 9, 17, 4, 3, 6, 8, 0, 18, 17, 12, 0, 7, 18, 13, 8, 12, 9, 16, 13, 9, 16, 3, 5, 15, 3, 21,
+         11, 16, 18, 20, 3, 0, 18, 2, 0, 16, 3, 6, 6, 9, 1, 10, 6, 19, 19, 0, 9, 1, 8, 7, 11, 16, 14, 1, 12, 3},
+    };
+    std::vector<Circuit_Parameters> scenarios = make_scenarios();
+    std::vector<Evaluation_Result> results;
+
+    for (std::vector<int>& circuit : circuits) {
+        int vector_size = circuit.size();
+        Simulate_Circuit_Scenarios(vector_size, circuit.data(), scenarios, results);
+        assert(results.size() == scenarios.size());
+        for (size_t s = 0; s < scenarios.size(); ++s) {
+            Evaluation_Result separate = Simulate_Circuit(vector_size, circuit.data(), scenarios[s]);
+            assert(results[s].converged == separate.converged);
+            assert(results[s].iterations == separate.iterations);
+            assert(std::fabs(results[s].performance - separate.performance) <= 1e-9 * std::fabs(separate.performance));
+            assert(std::fabs(results[s].recovery - separate.recovery) <= 1e-9);
+        }
+    }
+    std::cout << "Scenarios match separate runs test passed." << std::endl;
+}
+
+
+void test_scenario_aggregates() {
+    int ten_units[31] = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    std::vector<Circuit_Parameters> scenarios = make_scenarios();
+    std::vector<Evaluation_Result> results;
+    Simulate_Circuit_Scenarios(31, ten_units, scenarios, results);
+
+    double worst = results[0].performance;
+    double mean = 0.0;
+    for (const Evaluation_Result& result : results) {
+        worst = std::min(worst, result.performance);
+        mean += result.performance / results.size();
+    }
+    assert(Evaluate_Circuit_Scenarios(31, ten_units, scenarios) == worst);
+    assert(std::fabs(Evaluate_Circuit_Scenarios(31, ten_units, scenarios, Scenario_Aggregate::mean) - mean) < 1e-9 * std::fabs(mean));
+    assert(Scenario_Evaluator(scenarios)(31, ten_units) == worst);
+
+    // A user-chosen aggregate sees every result in scenario order
+    Scenario_Evaluator weighted(scenarios, [](const std::vector<Evaluation_Result>& scenario_results) {
+        return 0.5 * scenario_results[0].performance + 0.5 * scenario_results.back().performance;
+    });
+    assert(weighted(31, ten_units) == 0.5 * results[0].performance + 0.5 * results.back().performance);
+
+    // A single default scenario is the plain evaluation
+    std::vector<Circuit_Parameters> plant(1);
+    assert(std::fabs(Evaluate_Circuit_Scenarios(31, ten_units, plant) - Evaluate_Circuit(31, ten_units)) <= 1e-9 * std::fabs(Evaluate_Circuit(31, ten_units)));
+    std::cout << "Scenario aggregates test passed." << std::endl;
+}
+
+
+int main() {
+    test_default_evaluator();
+    test_set_parameter();
+    test_config_and_arguments();
+    test_parameters_reach_the_simulation();
+    test_scenarios_match_separate_runs();
+    test_scenario_aggregates();
+    std::cout << "All circuit evaluator tests passed." << std::endl;
+    return 0;
+}
@@ -1,7 +1,14 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 #include "CSimulator.h"
+#include "CircuitSimulator.h"
 
 int main(int argc, char *argv[])
 {
@@ -102,6 +109,336 @@ int main(int argc, char *argv[])
             return 1;
       }
 
+      // Test for function Simulate_Circuit
+      std::cout << "\n---------Test for function Simulate_Circuit---------\n";
+      Evaluation_Result converged_result = Simulate_Circuit(16, vec1);
+      std::cout << "Simulate_Circuit(16, vec1): performance " << converged_result.performance
+                << " recovery " << converged_result.recovery << " grade " << converged_result.grade
+                << " iterations " << converged_result.iterations << " converged " << converged_result.converged << "\n";
+      if (converged_result.performance == result &&
+          converged_result.converged &&
+          converged_result.iterations > 0 && converged_result.iterations < 1000 &&
+          converged_result.recovery > 0.0 && converged_result.recovery <= 1.0 &&
+          converged_result.grade > 0.0 && converged_result.grade <= 1.0)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      Evaluation_Result diverged_result = Simulate_Circuit(10, vec2);
+      std::cout << "Simulate_Circuit(10, vec2): performance " << diverged_result.performance
+                << " iterations " << diverged_result.iterations << " converged " << diverged_result.converged << "\n";
+      if (diverged_result.performance == -67500.0 &&
+          !diverged_result.converged &&
+          diverged_result.iterations == 1000)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the Anderson-accelerated solver reaches the same steady state in fewer sweeps
+      std::cout << "\n---------Test for Solver_Mode::anderson---------\n";
+      Circuit_Parameters anderson_parameters;
+      anderson_parameters.solver = Solver_Mode::anderson;
+      Evaluation_Result anderson_result1 = Simulate_Circuit(16, vec1, anderson_parameters);
+      Evaluation_Result anderson_result6 = Simulate_Circuit(76, vec6, anderson_parameters);
+      Evaluation_Result jacobi_result6 = Simulate_Circuit(76, vec6);
+      std::cout << "anderson vec1: " << anderson_result1.performance << " in " << anderson_result1.iterations
+                << " sweeps (jacobi " << converged_result.iterations << ")\n";
+      std::cout << "anderson vec6: " << anderson_result6.performance << " in " << anderson_result6.iterations
+                << " sweeps (jacobi " << jacobi_result6.iterations << ")\n";
+      if (anderson_result1.converged && std::fabs(anderson_result1.performance - 167.378) < 1.0e-2 &&
+          anderson_result1.iterations < converged_result.iterations &&
+          anderson_result6.converged && std::fabs(anderson_result6.performance - (-292.084)) < 1.0e-2 &&
+          anderson_result6.iterations < jacobi_result6.iterations)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the in-place feed-first sweep reaches the same steady state in fewer sweeps
+      std::cout << "\n---------Test for Solver_Mode::gauss_seidel---------\n";
+      Circuit_Parameters gauss_seidel_parameters;
+      gauss_seidel_parameters.solver = Solver_Mode::gauss_seidel;
+      Evaluation_Result gauss_seidel_result1 = Simulate_Circuit(16, vec1, gauss_seidel_parameters);
+      Evaluation_Result gauss_seidel_result6 = Simulate_Circuit(76, vec6, gauss_seidel_parameters);
+      Evaluation_Result gauss_seidel_result2 = Simulate_Circuit(10, vec2, gauss_seidel_parameters);
+      std::cout << "gauss_seidel vec1: " << gauss_seidel_result1.performance << " in " << gauss_seidel_result1.iterations
+                << " sweeps (jacobi " << converged_result.iterations << ")\n";
+      std::cout << "gauss_seidel vec6: " << gauss_seidel_result6.performance << " in " << gauss_seidel_result6.iterations
+                << " sweeps (jacobi " << jacobi_result6.iterations << ")\n";
+      if (gauss_seidel_result1.converged && std::fabs(gauss_seidel_result1.performance - 167.378) < 1.0e-2 &&
+          gauss_seidel_result1.iterations < converged_result.iterations &&
+          gauss_seidel_result6.converged && std::fabs(gauss_seidel_result6.performance - (-292.084)) < 1.0e-2 &&
+          gauss_seidel_result6.iterations < jacobi_result6.iterations &&
+          !gauss_seidel_result2.converged && gauss_seidel_result2.performance == -67500.0)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test splitting the units across threads gives the same result as the serial gather
+      std::cout << "\n---------Test for Circuit_Parameters::parallel_units---------\n";
+      Circuit_Parameters parallel_parameters;
+      parallel_parameters.parallel_units = true;
+      Evaluation_Result parallel_result6 = Simulate_Circuit(76, vec6, parallel_parameters);
+      std::cout << "parallel vec6: " << parallel_result6.performance << " in " << parallel_result6.iterations << " sweeps\n";
+      if (parallel_result6.converged && parallel_result6.iterations == jacobi_result6.iterations &&
+          std::fabs(parallel_result6.performance - jacobi_result6.performance) < 1.0e-9)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the batch gives the same results as one circuit at a time, with more circuits than lanes
+      std::cout << "\n---------Test for function Simulate_Circuits_Batch---------\n";
+      const int batch_size = 2 * BatchWorkspace::lanes + 3;
+      std::vector<int> batch_vectors;
+      for (int c = 0; c < batch_size; c++)
+      {
+            // Variations of vec4, some of which do not converge
+            std::vector<int> circuit(vec4, vec4 + 31);
+            circuit[1 + (5 * c) % 30] = (c * 7) % 12;
+            batch_vectors.insert(batch_vectors.end(), circuit.begin(), circuit.end());
+      }
+      std::vector<Evaluation_Result> batch_results(batch_size);
+      Simulate_Circuits_Batch(31, batch_size, batch_vectors.data(), batch_results.data());
+      std::vector<double> batch_performances(batch_size);
+      Evaluate_Circuits_Batch(31, batch_size, batch_vectors.data(), batch_performances.data());
+      bool batch_matches = true;
+      int batch_converged = 0;
+      for (int c = 0; c < batch_size; c++)
+      {
+            Evaluation_Result single = Simulate_Circuit(31, batch_vectors.data() + 31 * c);
+            batch_converged += single.converged;
+            if (batch_results[c].converged != single.converged || batch_results[c].iterations != single.iterations ||
+                std::fabs(batch_results[c].performance - single.performance) > 1.0e-9 * (1.0 + std::fabs(single.performance)) ||
+                std::fabs(batch_results[c].recovery - single.recovery) > 1.0e-9 ||
+                batch_performances[c] != batch_results[c].performance)
+            {
+                  std::cout << "circuit " << c << ": batch " << batch_results[c].performance << " in " << batch_results[c].iterations
+                            << " sweeps, single " << single.performance << " in " << single.iterations << " sweeps\n";
+                  batch_matches = false;
+            }
+      }
+      std::cout << batch_size << " circuits, " << batch_converged << " converged\n";
+      if (batch_matches && batch_converged > 0 && batch_converged < batch_size)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the fixed-size simulator agrees with the dynamic one, with and without convergence
+      std::cout << "\n---------Test for CircuitSimulator<10>---------\n";
+      CircuitSimulator<10> fixed_simulator;
+      SimulationWorkspace dynamic_workspace;
+      bool fixed_matches = true;
+      for (int c = 0; c < batch_size; c++)
+      {
+            int *circuit = batch_vectors.data() + 31 * c;
+            Evaluation_Result fixed_result = fixed_simulator.simulate(circuit);
+            Evaluation_Result dynamic_result = dynamic_workspace.simulate(31, circuit);
+            Evaluation_Result dispatched_result = Simulate_Circuit(31, circuit);
+            if (fixed_result.converged != dynamic_result.converged || fixed_result.iterations != dynamic_result.iterations ||
+                std::fabs(fixed_result.performance - dynamic_result.performance) > 1.0e-9 * (1.0 + std::fabs(dynamic_result.performance)) ||
+                std::fabs(dispatched_result.performance - dynamic_result.performance) > 1.0e-9 * (1.0 + std::fabs(dynamic_result.performance)))
+            {
+                  std::cout << "circuit " << c << ": fixed " << fixed_result.performance << " in " << fixed_result.iterations
+                            << " sweeps, dynamic " << dynamic_result.performance << " in " << dynamic_result.iterations << " sweeps\n";
+                  fixed_matches = false;
+            }
+      }
+      Evaluation_Result fixed_result4 = fixed_simulator.simulate(vec4);
+      std::cout << "CircuitSimulator<10> vec4: " << fixed_result4.performance << "\n";
+      if (fixed_matches && std::fabs(fixed_result4.performance - (-294.262)) < 1.0e-3)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test a warm start from converged flows reaches the same steady state
+      std::cout << "\n---------Test for warm start from a Flow_State---------\n";
+      Flow_State parent_state;
+      Evaluation_Result parent_result = Simulate_Circuit(76, vec6, Circuit_Parameters(), nullptr, &parent_state);
+      Evaluation_Result restarted_result = Simulate_Circuit(76, vec6, Circuit_Parameters(), &parent_state);
+      int child6[76];
+      std::copy(vec6, vec6 + 76, child6);
+      child6[29] = 4;
+      Evaluation_Result cold_child = Simulate_Circuit(76, child6);
+      Evaluation_Result warm_child = Simulate_Circuit(76, child6, Circuit_Parameters(), &parent_state);
+      Flow_State fixed_state;
+      Simulate_Circuit(31, vec4, Circuit_Parameters(), nullptr, &fixed_state);
+      Evaluation_Result fixed_restarted = Simulate_Circuit(31, vec4, Circuit_Parameters(), &fixed_state);
+      Evaluation_Result mismatched_result = Simulate_Circuit(31, vec4, Circuit_Parameters(), &parent_state);
+      std::cout << "restart vec6 in " << restarted_result.iterations << " sweeps, child cold " << cold_child.performance
+                << " in " << cold_child.iterations << " sweeps, warm " << warm_child.performance << " in "
+                << warm_child.iterations << " sweeps\n";
+      if (parent_state.matches(25) && restarted_result.converged && restarted_result.iterations <= 2 &&
+          std::fabs(restarted_result.performance - parent_result.performance) < 1.0e-3 &&
+          cold_child.converged && warm_child.converged && warm_child.iterations < cold_child.iterations &&
+          std::fabs(warm_child.performance - cold_child.performance) < 1.0e-2 &&
+          fixed_restarted.iterations <= 2 && std::fabs(fixed_restarted.performance - result4) < 1.0e-3 &&
+          mismatched_result.performance == result4 && mismatched_result.iterations == Simulate_Circuit(31, vec4).iterations)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the per-thread simulation counters and their CSV export
+      std::cout << "\n---------Test for Simulation_Statistics---------\n";
+      Collect_Simulation_Statistics();
+      Simulation_Statistics::sample_residuals(true);
+      std::vector<Evaluation_Result> counted_results(batch_size);
+      Simulate_Circuits_Batch(31, batch_size, batch_vectors.data(), counted_results.data());
+      counted_results.push_back(Simulate_Circuit(16, vec1));
+      counted_results.push_back(Simulate_Circuit(10, vec2));
+      Simulation_Statistics::sample_residuals(false);
+      Simulation_Statistics counted = Collect_Simulation_Statistics();
+      Simulation_Statistics after_reset = Collect_Simulation_Statistics();
+
+      long long expected_sweeps = 0;
+      long long expected_converged = 0;
+      long long expected_long_runs = 0;
+      bool residuals_consistent = true;
+      for (const Evaluation_Result &counted_result : counted_results)
+      {
+            expected_sweeps += counted_result.iterations;
+            expected_converged += counted_result.converged;
+            expected_long_runs += counted_result.iterations >= 512;
+            residuals_consistent = residuals_consistent && (counted_result.residual <= 1.0e-6) == counted_result.converged;
+      }
+      long long histogram_total = 0;
+      for (int b = 0; b < Simulation_Statistics::num_buckets; b++)
+      {
+            histogram_total += counted.sweep_histogram[b];
+      }
+      bool written = Write_Simulation_Statistics({counted, after_reset}, "test_simulation_statistics.csv");
+      std::ifstream statistics_file("test_simulation_statistics.csv");
+      std::string header_line, row_line;
+      int csv_rows = 0;
+      std::getline(statistics_file, header_line);
+      while (std::getline(statistics_file, row_line))
+      {
+            csv_rows++;
+      }
+      statistics_file.close();
+      std::remove("test_simulation_statistics.csv");
+      std::cout << counted.evaluations << " simulations, " << counted.converged << " converged, " << counted.sweeps
+                << " sweeps, longest " << counted.max_sweeps << "\n";
+      if (counted.evaluations == static_cast<long long>(counted_results.size()) && counted.sweeps == expected_sweeps &&
+          counted.converged == expected_converged && counted.max_sweeps == 1000 && histogram_total == counted.evaluations &&
+          counted.residual_samples[0] == counted.evaluations && counted.residual_samples[9] == expected_long_runs && residuals_consistent &&
+          after_reset.evaluations == 0 && written && header_line.rfind("period,evaluations,", 0) == 0 && csv_rows == 2)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the early abort of circuits that cannot reach a threshold
+      std::cout << "\n---------Test for Circuit_Parameters::abort_below---------\n";
+      Evaluation_Result full6 = Simulate_Circuit(76, vec6);
+      Circuit_Parameters reachable_parameters;
+      reachable_parameters.abort_below = full6.performance - 1.0;
+      Circuit_Parameters unreachable_parameters;
+      unreachable_parameters.abort_below = full6.performance + 1.0;
+      Circuit_Parameters penalty_parameters;
+      penalty_parameters.abort_below = -1000.0;
+      Evaluation_Result reachable6 = Simulate_Circuit(76, vec6, reachable_parameters);
+      Evaluation_Result unreachable6 = Simulate_Circuit(76, vec6, unreachable_parameters);
+      Evaluation_Result diverging2 = Simulate_Circuit(10, vec2, penalty_parameters);
+      std::cout << "vec6 below " << unreachable_parameters.abort_below << ": " << unreachable6.performance << " after "
+                << unreachable6.iterations << " of " << full6.iterations << " sweeps, vec2 given up after "
+                << diverging2.iterations << " sweeps\n";
+      if (!reachable6.aborted && reachable6.performance == full6.performance && reachable6.iterations == full6.iterations &&
+          unreachable6.aborted && !unreachable6.converged && unreachable6.performance < unreachable_parameters.abort_below &&
+          unreachable6.iterations < full6.iterations &&
+          diverging2.aborted && diverging2.performance == result2 && diverging2.iterations < 1000 &&
+          Evaluate_Circuit_Bounded(16, vec1, -std::numeric_limits<double>::infinity()) == result &&
+          Evaluate_Circuit_Bounded(76, vec6, unreachable_parameters.abort_below) == unreachable6.performance)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
+      // Test the flows handed over after the sweeps trade buffers, and the single precision start
+      std::cout << "\n---------Test for Circuit_Parameters::single_precision_until---------\n";
+      Circuit_Parameters capped_parameters;
+      capped_parameters.max_iterations = 7;
+      Flow_State capped_dynamic, capped_fixed;
+      SimulationWorkspace capped_workspace;
+      capped_workspace.simulate(31, vec4, capped_parameters, nullptr, &capped_dynamic);
+      Simulate_Circuit(31, vec4, capped_parameters, nullptr, &capped_fixed);
+      // Both simulators must hand over the flows of the seventh sweep, not those of the sixth
+      double capped_difference = 0.0;
+      for (int i = 0; i < 10; i++)
+      {
+            capped_difference = std::max(capped_difference, std::fabs(capped_dynamic.flow_G[i] - capped_fixed.flow_G[i]));
+            capped_difference = std::max(capped_difference, std::fabs(capped_dynamic.flow_W[i] - capped_fixed.flow_W[i]));
+      }
+
+      Circuit_Parameters mixed_parameters;
+      mixed_parameters.single_precision_until = 1e-3;
+      Evaluation_Result mixed4 = Simulate_Circuit(31, vec4, mixed_parameters);
+      Evaluation_Result mixed6 = Simulate_Circuit(76, vec6, mixed_parameters);
+      Evaluation_Result mixed2 = Simulate_Circuit(10, vec2, mixed_parameters);
+      Evaluation_Result double6 = Simulate_Circuit(76, vec6);
+      std::cout << "vec4 " << mixed4.performance << " (double " << result4 << "), vec6 " << mixed6.performance
+                << " after " << mixed6.iterations << " sweeps (double " << double6.performance << " after "
+                << double6.iterations << ")\n";
+      if (capped_dynamic.flow_G.size() == 10 && capped_difference < 1.0e-12 &&
+          mixed4.converged && std::fabs(mixed4.performance - result4) < 1.0e-6 * std::fabs(result4) &&
+          mixed6.converged && mixed6.residual <= mixed_parameters.tolerance &&
+          std::fabs(mixed6.performance - double6.performance) < 1.0e-6 * std::fabs(double6.performance) &&
+          !mixed2.converged && mixed2.performance == result2)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
       // Test for function calculate_residence_time
       std::cout
           << "\n---------Test for function calculate_residence_time---------\n";
@@ -141,6 +478,46 @@ int main(int argc, char *argv[])
             return 1;
       }
 
+      // Test the folded kernel matches calculate_recovery, and the table stays within its error bound
+      std::cout << "\n---------Test for Recovery_Kernel---------\n";
+      Recovery_Kernel kernel(constants);
+      Recovery_Kernel tabulated_kernel(constants);
+      tabulated_kernel.tabulate(1.0e-7);
+      double folded_error = 0.0;
+      double tabulated_error = 0.0;
+      for (double tau = 0.0; tau < 2.0 * tabulated_kernel.table_max_tau; tau += 0.37)
+      {
+            Recovery exact = calculate_recovery(constants, tau);
+            Recovery folded = kernel.recovery(tau);
+            Recovery interpolated = tabulated_kernel.recovery(tau);
+            folded_error = std::max({folded_error, std::fabs(folded.concentrate_gerardium - exact.concentrate_gerardium),
+                                     std::fabs(folded.concentrate_waste - exact.concentrate_waste),
+                                     std::fabs(folded.inter_gerardium - exact.inter_gerardium),
+                                     std::fabs(folded.inter_waste - exact.inter_waste)});
+            tabulated_error = std::max({tabulated_error, std::fabs(interpolated.concentrate_gerardium - exact.concentrate_gerardium),
+                                        std::fabs(interpolated.concentrate_waste - exact.concentrate_waste),
+                                        std::fabs(interpolated.inter_gerardium - exact.inter_gerardium),
+                                        std::fabs(interpolated.inter_waste - exact.inter_waste)});
+      }
+      Flow_rates kernel_flows = kernel.unit_flows(Fg, Fw);
+      Flow_rates unit_flows = calculate_unit_flows(calculate_recovery(constants, calculate_residence_time(constants, Fg, Fw)), Fg, Fw);
+      Circuit_Parameters table_parameters;
+      table_parameters.recovery_table_error = 1.0e-7;
+      Evaluation_Result table_result6 = Simulate_Circuit(76, vec6, table_parameters);
+      std::cout << "folded error " << folded_error << ", tabulated error " << tabulated_error
+                << ", tabulated vec6 " << table_result6.performance << "\n";
+      if (folded_error < 1.0e-15 && tabulated_error <= 1.0e-7 &&
+          std::fabs(kernel_flows.cg - unit_flows.cg) < 1.0e-12 && std::fabs(kernel_flows.tw - unit_flows.tw) < 1.0e-12 &&
+          table_result6.converged && std::fabs(table_result6.performance - (-292.084)) < 1.0e-2)
+      {
+            std::cout << "pass\n";
+      }
+      else
+      {
+            std::cout << "fail\n";
+            return 1;
+      }
+
       // Test for function calculate_flow_rate
       std::cout << "\n---------Test for function calculate_flow_rate---------\n";
       std::vector<double> all_flow_rate = calculate_flow_rate(constants, recovery, Fg, Fw);
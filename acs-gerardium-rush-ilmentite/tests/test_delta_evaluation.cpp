@@ -0,0 +1,134 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "CCircuit.h"
+#include "CSimulator.h"
+#include "Delta_Evaluation.h"
+
+
+/**
+ * @brief Checks a snapshot against a fresh Check_Validity and Evaluate_Circuit of its vector.
+ *
+ * @param snapshot The snapshot to check.
+ * @param same_convergence Cleared if only one of the two simulations reached the tolerance.
+ * @return True if validity matches exactly and, when both converged, the fitness within the convergence tolerance.
+ */
+bool matches_full_evaluation(const Circuit_Snapshot& snapshot, bool& same_convergence) {
+    same_convergence = true;
+    std::vector<int> vector = snapshot.genes;
+    bool valid = Check_Validity(vector.size(), vector.data());
+    if (valid != snapshot.valid) {
+        return false;
+    }
+    if (!valid) {
+        return true;
+    }
+    Evaluation_Result full = Simulate_Circuit(vector.size(), vector.data());
+    if (full.converged != snapshot.result.converged) {
+        // A circuit that needs close to max_iterations sweeps can end on either side of the cap
+        same_convergence = false;
+        return true;
+    }
+    return std::fabs(full.performance - snapshot.fitness) <= 1e-3 * std::max(1.0, std::fabs(full.performance));
+}
+
+
+void test_analyse_circuit() {
+    int valid_vector[31] = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    int invalid_vector[7] = {0, 1, 0, 2, 3, 1, 2};
+    Circuit_Snapshot snapshot;
+
+    Analyse_Circuit(31, valid_vector, snapshot);
+    assert(snapshot.valid && snapshot.reachable_units == 10 && snapshot.missing_values == 0);
+    assert(snapshot.fitness == Evaluate_Circuit(31, valid_vector));
+    assert(snapshot.flows.matches(10));
+
+    Analyse_Circuit(7, invalid_vector, snapshot);
+    assert(!snapshot.valid && snapshot.fitness < -1e300);
+    std::cout << "Analyse circuit test passed." << std::endl;
+}
+
+
+void test_single_gene_change() {
+    int vector[31] = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    Circuit_Snapshot parent, child;
+    Analyse_Circuit(31, vector, parent);
+
+    // Sending the tailings of unit 0 to unit 0 is a self-recycle
+    int gene = 3;
+    vector[gene] = 0;
+    Reanalyse_Circuit(parent, vector, &gene, 1, child);
+    assert(!child.valid && child.invalid_units == 1);
+    assert(child.flows.matches(10));
+
+    // Undoing the change in place restores the parent's analysis
+    vector[gene] = 7;
+    Reanalyse_Circuit(child, vector, &gene, 1, child);
+    assert(child.valid && child.invalid_units == 0 && child.reachable_units == 10);
+    assert(std::fabs(child.fitness - parent.fitness) <= 1e-3 * std::fabs(parent.fitness));
+    std::cout << "Single gene change test passed." << std::endl;
+}
+
+
+void test_random_mutations() {
+    std::vector<std::vector<int>> circuits = {
+        {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2},
+        {0, 1, 1, 2, 2, 3, 3, 0, 4, 1, 0, 2, 6, 5, 0, 6},
+        {0, 4, 1, 8, 12, 9, 17, 4, 3, 6, 8, 0, 18, 17, 12, 0, 7, 18, 13, 8, 12, 9, 16, 13, 9, 16, 3, 5, 15, 3, 21,
+         11, 16, 18, 20, 3, 0, 18, 2, 0, 16, 3, 6, 6, 9, 1, 10, 6, 19, 19, 0, 9, 1, 8, 7, 11, 16, 14, 1, 12, 3},
+    };
+    std::mt19937 generator(2024);
+    int checked = 0, valid_children = 0, convergence_differs = 0;
+
+    for (std::vector<int>& circuit : circuits) {
+        int vector_size = circuit.size();
+        int n = (vector_size - 1) / 3;
+        Circuit_Snapshot parent, child, last_valid;
+        Analyse_Circuit(vector_size, circuit.data(), parent);
+        last_valid = parent;
+        std::uniform_int_distribution<int> gene_distribution(0, vector_size - 1);
+        // Mostly valid destinations, with a few out of range to exercise the full check
+        std::uniform_int_distribution<int> value_distribution(-1, n + 3);
+
+        for (int step = 0; step < 300; ++step) {
+            int changed[2] = {gene_distribution(generator), gene_distribution(generator)};
+            int num_changed = step % 3 == 0 ? 2 : 1;
+            std::vector<int> child_vector = parent.genes;
+            for (int i = 0; i < num_changed; ++i) {
+                child_vector[changed[i]] = value_distribution(generator);
+            }
+
+            Reanalyse_Circuit(parent, child_vector.data(), changed, num_changed, child);
+            assert(child.genes == child_vector);
+            bool same_convergence = true;
+            assert(matches_full_evaluation(child, same_convergence));
+            convergence_differs += !same_convergence;
+            ++checked;
+            valid_children += child.valid;
+
+            // Walk on from valid children; now and then take one step from an invalid child
+            if (child.valid) {
+                parent = child;
+                last_valid = child;
+            } else if (step % 7 == 0) {
+                parent = child;
+            } else {
+                parent = last_valid;
+            }
+        }
+    }
+    assert(valid_children > 0);
+    assert(convergence_differs * 20 < valid_children);
+    std::cout << "Random mutation test passed (" << valid_children << " of " << checked << " children valid)." << std::endl;
+}
+
+
+int main() {
+    test_analyse_circuit();
+    test_single_gene_change();
+    test_random_mutations();
+    std::cout << "All delta evaluation tests passed." << std::endl;
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <omp.h>
+#include "Fitness_Cache.h"
+
+
+void test_lookup_and_insert() {
+    Fitness_Cache cache(64, 4);
+    std::vector<int> a{0, 1, 2, 3, 4};
+    std::vector<int> b{0, 1, 2, 4, 3};
+    double fitness = 0.0;
+
+    assert(!cache.lookup(a.size(), a.data(), fitness));
+    cache.insert(a.size(), a.data(), 12.5);
+    assert(cache.lookup(a.size(), a.data(), fitness) && fitness == 12.5);
+    // A permutation of the same genes is a different individual
+    assert(!cache.lookup(b.size(), b.data(), fitness));
+
+    // Inserting again replaces the fitness without growing the cache
+    cache.insert(a.size(), a.data(), -3.0);
+    assert(cache.lookup(a.size(), a.data(), fitness) && fitness == -3.0);
+    assert(cache.size() == 1);
+
+    Fitness_Cache::Statistics statistics = cache.statistics();
+    assert(statistics.hits == 2 && statistics.misses == 2 && statistics.hit_rate() == 0.5);
+    std::cout << "Lookup and insert test passed." << std::endl;
+}
+
+
+void test_disabled_cache() {
+    Fitness_Cache cache(0);
+    std::vector<int> a{0, 1, 2, 3, 4};
+    double fitness = 0.0;
+
+    assert(!cache.enabled());
+    cache.insert(a.size(), a.data(), 1.0);
+    assert(!cache.lookup(a.size(), a.data(), fitness));
+    assert(cache.size() == 0);
+    std::cout << "Disabled cache test passed." << std::endl;
+}
+
+
+void test_clock_eviction() {
+    // One shard, so the eviction order is deterministic
+    Fitness_Cache cache(4, 1);
+    std::vector<std::vector<int>> individuals;
+    for (int i = 0; i < 6; ++i) {
+        individuals.push_back({i, i + 1, i + 2});
+    }
+    double fitness = 0.0;
+
+    for (int i = 0; i < 4; ++i) {
+        cache.insert(3, individuals[i].data(), i);
+    }
+    // Individual 0 is referenced, so the first eviction skips it and takes individual 1
+    assert(cache.lookup(3, individuals[0].data(), fitness));
+    cache.insert(3, individuals[4].data(), 4);
+    assert(cache.size() == 4);
+    assert(cache.lookup(3, individuals[0].data(), fitness) && fitness == 0);
+    assert(!cache.lookup(3, individuals[1].data(), fitness));
+    assert(cache.lookup(3, individuals[4].data(), fitness) && fitness == 4);
+
+    // The cache never grows beyond its capacity
+    for (int i = 0; i < 100; ++i) {
+        std::vector<int> individual{i, -i, 2 * i};
+        cache.insert(3, individual.data(), i);
+    }
+    assert(cache.size() == 4);
+    std::cout << "CLOCK eviction test passed." << std::endl;
+}
+
+
+void test_concurrent_access() {
+    Fitness_Cache cache(4096);
+    const int num_individuals = 256;
+    bool correct = true;
+
+    #pragma omp parallel for reduction(&&:correct)
+    for (int i = 0; i < 4 * num_individuals; ++i) {
+        int id = i % num_individuals;
+        std::vector<int> individual{id, id % 7, id / 7, 3};
+        double fitness = 0.0;
+        if (cache.lookup(individual.size(), individual.data(), fitness)) {
+            correct = correct && fitness == 0.5 * id;
+        } else {
+            cache.insert(individual.size(), individual.data(), 0.5 * id);
+        }
+    }
+    assert(correct);
+    assert(cache.size() == num_individuals);
+    Fitness_Cache::Statistics statistics = cache.statistics();
+    assert(statistics.hits + statistics.misses == 4 * num_individuals);
+    std::cout << "Concurrent access test passed with " << omp_get_max_threads() << " threads." << std::endl;
+}
+
+
+int main() {
+    test_lookup_and_insert();
+    test_disabled_cache();
+    test_clock_eviction();
+    test_concurrent_access();
+    std::cout << "All fitness cache tests passed." << std::endl;
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cmath>
 #include "Genetic_Algorithm.h"
+#include "Population_Buffer.h"
 
 // This answer vector is used in the test function
 int test_answer[] = {2, 1, 1, 2, 0, 2, 3, 0, 4, 4};
@@ -92,6 +93,32 @@ void test_initialize_population() {
 }
 
 
+// Accepts vectors whose second gene is even; safe to call from several threads
+bool even_second_gene(int, int *vector) {
+    return vector[1] % 2 == 0;
+}
+
+
+void test_initialize_population_checks_every_slot() {
+    int population_size = 200;
+    int vector_size = 10;
+    int initial_vector[] = {0, 1, 2, 3, 4, 5, 0, 0, 0, 0};
+
+    auto population = initialize_population(population_size, vector_size, initial_vector, even_second_gene, 0.2);
+
+    // Every slot is filled once, the initial vector first, and every later slot passes the validity check
+    assert(static_cast<int>(population.size()) == population_size);
+    assert(std::equal(population[0].begin(), population[0].end(), initial_vector));
+    for (int i = 1; i < population_size; ++i) {
+        assert(static_cast<int>(population[i].size()) == vector_size);
+        for (int gene : population[i]) {
+            assert(gene >= 0 && gene <= 5);
+        }
+        assert(even_second_gene(vector_size, population[i].data()));
+    }
+    std::cout << "Parallel population initialization test passed." << std::endl;
+}
+
 bool check_values_within_bounds(const std::vector<int>& vector, int max_unit) {
     for (int value : vector) {
         if (value < 0 || value > max_unit) {
@@ -174,6 +201,47 @@ bool validate_distribution(const std::vector<int>& selections, const std::vector
     return true;
 }
 
+void check_breed_generation(int population_size, int elitism_count) {
+    int vector_size = 9;
+    int number_of_units = 5;
+    Population_Buffer buffer(population_size, vector_size);
+    for (int i = 0; i < population_size; ++i) {
+        for (int j = 0; j < vector_size; ++j) {
+            buffer.individual(i)[j] = (i + j) % number_of_units;
+            buffer.next(i)[j] = -1;
+        }
+    }
+    std::vector<int> ranking(population_size);
+    std::vector<double> cumulative_fitness(population_size);
+    for (int i = 0; i < population_size; ++i) {
+        ranking[i] = population_size - 1 - i;
+        cumulative_fitness[i] = i + 1.0;
+    }
+    Algorithm_Parameters parameters = {100, 1.0, 1.0, 0.0, 0};
+
+    breed_generation(buffer, ranking, elitism_count, cumulative_fitness, parameters, 1.0, 1, number_of_units);
+
+    // The elites are copied unchanged, and every other slot holds a child with genes in range
+    for (int i = 0; i < elitism_count; ++i) {
+        assert(std::equal(buffer.next(i), buffer.next(i) + vector_size, buffer.individual(ranking[i])));
+    }
+    for (int i = elitism_count; i < population_size; ++i) {
+        for (int j = 0; j < vector_size; ++j) {
+            assert(buffer.next(i)[j] >= 0 && buffer.next(i)[j] <= number_of_units - 1);
+        }
+    }
+}
+
+
+void test_breed_generation() {
+    // An odd and an even number of children
+    check_breed_generation(10, 3);
+    check_breed_generation(10, 2);
+    check_breed_generation(7, 0);
+    std::cout << "Breed generation test passed." << std::endl;
+}
+
+
 void test_select_index() {
     // Uniform distribution test
     std::vector<double> cumulative_fitness_uniform{1.0, 2.0, 3.0, 4.0, 5.0};
@@ -254,6 +322,8 @@ int main() {
 
     test_initialize_population();
 
+    test_initialize_population_checks_every_slot();
+
     test_mutation();
 
     test_mutate_vector();
@@ -262,6 +332,8 @@ int main() {
 
     test_select_index();
 
+    test_breed_generation();
+
     try {
         test_select_index();
     } catch (const std::exception& e) {
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "Population_Buffer.h"
+#include "Genetic_Algorithm.h"
+
+
+void test_layout() {
+    Population_Buffer buffer(5, 31);
+
+    // Every individual of both generations starts on a cache line, with room for all its genes
+    assert(buffer.size() == 5 && buffer.vector_size() == 31);
+    assert(buffer.stride() >= 31 && buffer.stride() * sizeof(int) % Population_Buffer::alignment == 0);
+    for (int i = 0; i < buffer.size(); ++i) {
+        assert(reinterpret_cast<std::uintptr_t>(buffer.individual(i)) % Population_Buffer::alignment == 0);
+        assert(reinterpret_cast<std::uintptr_t>(buffer.next(i)) % Population_Buffer::alignment == 0);
+        assert(buffer.individual(i) + buffer.stride() * (buffer.size() - i) <= buffer.next(0) ||
+               buffer.next(i) + buffer.stride() * (buffer.size() - i) <= buffer.individual(0));
+    }
+    std::cout << "Layout test passed." << std::endl;
+}
+
+
+void test_swap_and_store() {
+    std::vector<std::vector<int>> population{{0, 1, 2}, {3, 4, 5}, {6, 7, 8}, {9, 10, 11}};
+    Population_Buffer buffer(population);
+    for (int i = 0; i < 4; ++i) {
+        assert(std::equal(population[i].begin(), population[i].end(), buffer.individual(i)));
+    }
+
+    // Filling the next generation leaves the current one alone until the swap, which moves no genes
+    int *current = buffer.individual(0);
+    int *next = buffer.next(0);
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            buffer.next(i)[j] = -(3 * i + j);
+        }
+    }
+    assert(buffer.individual(3)[2] == 11);
+    buffer.swap();
+    assert(buffer.individual(0) == next && buffer.next(0) == current);
+
+    std::vector<std::vector<int>> stored(1);
+    buffer.store(stored);
+    assert(stored.size() == 4);
+    for (int i = 0; i < 4; ++i) {
+        assert(stored[i] == std::vector<int>({-3 * i, -3 * i - 1, -3 * i - 2}));
+    }
+    std::cout << "Swap and store test passed." << std::endl;
+}
+
+
+void test_operators_in_place() {
+    Population_Buffer buffer(2, 6);
+    for (int j = 0; j < 6; ++j) {
+        buffer.individual(0)[j] = 1;
+        buffer.individual(1)[j] = 2;
+    }
+
+    // No crossover or mutation at a zero rate
+    crossover(buffer.individual(0), buffer.individual(1), 6, 0.0, 9);
+    mutate_vector(buffer.individual(0), 6, 0.0, 9);
+    NonUniform_Mutation(buffer.individual(1), 6, 0.0, 9, 1, 100);
+    for (int j = 0; j < 6; ++j) {
+        assert(buffer.individual(0)[j] == 1 && buffer.individual(1)[j] == 2);
+    }
+
+    // A crossover swaps a non-empty tail, and genes stay within bounds after mutation
+    crossover(buffer.individual(0), buffer.individual(1), 6, 1.0, 9);
+    assert(buffer.individual(0)[0] == 1 && buffer.individual(0)[5] == 2);
+    assert(buffer.individual(1)[0] == 2 && buffer.individual(1)[5] == 1);
+    mutate_vector(buffer.individual(0), 6, 1.0, 9);
+    NonUniform_Mutation(buffer.individual(1), 6, 1.0, 9, 1, 100);
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 6; ++j) {
+            assert(buffer.individual(i)[j] >= 0 && buffer.individual(i)[j] <= 9);
+        }
+    }
+    std::cout << "In-place operators test passed." << std::endl;
+}
+
+
+int main() {
+    test_layout();
+    test_swap_and_store();
+    test_operators_in_place();
+    std::cout << "All population buffer tests passed." << std::endl;
+    return 0;
+}
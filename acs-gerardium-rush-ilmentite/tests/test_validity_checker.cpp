@@ -7,6 +7,7 @@
 #include <tuple>
 #include <algorithm>
 #include <numeric>
+#include <random>
 
 /**
  * @brief A test class inheriting from Circuit to access private members for testing.
@@ -119,6 +120,36 @@ public:
         return check_feed_value(const_cast<int*>(circuit_vector.data()));
     }
 
+    /**
+     * Runs the separate checks in the order Check_Validity used to, on units built the way it
+     * used to build them, and names the first rule broken.
+     *
+     * @param circuit_vector A vector of integers representing the circuit.
+     * @return The code the separate checks give.
+     */
+    Validity_Code separate_checks_code(const std::vector<int>& circuit_vector) {
+        int vector_size = circuit_vector.size();
+        int* vector = const_cast<int*>(circuit_vector.data());
+        units.assign((vector_size - 1) % 3 == 0 ? vector_size / 3 : vector_size / 3 + 1, CUnit());
+        for (int i = 0; i < static_cast<int>(units.size()); ++i) {
+            units[i].conc_num = vector[3 * i + 1];
+            if (vector_size > 3 * i + 2)
+                units[i].inter_num = vector[3 * i + 2];
+            if (vector_size > 3 * i + 3)
+                units[i].tails_num = vector[3 * i + 3];
+        }
+        if (!check_values(vector_size, vector)) return Validity_Code::missing_value;
+        if (!is_reachable()) return Validity_Code::unreachable_unit;
+        if (!concentrate_tailing_check()) return Validity_Code::misrouted_outlet;
+        if (!self_recycle_check()) return Validity_Code::self_recycle;
+        if (!same_unit_dest_check()) return Validity_Code::same_destination;
+        if (!end_of_vector_check()) return Validity_Code::missing_stream;
+        if (!max_value_check(vector_size, vector)) return Validity_Code::value_too_large;
+        if (!tail_percentage_to_concentrate_outlet_check()) return Validity_Code::tails_to_concentrate;
+        if (!check_feed_value(vector)) return Validity_Code::bad_feed;
+        return Validity_Code::valid;
+    }
+
     /**
      * Tests all checks on a circuit vector and records the names of the checks that failed.
      *
@@ -466,6 +497,317 @@ bool extra_valid_check(std::vector<std::vector<int>>& validArrayColumn, std::vec
     return allPass;
 }
 
+/**
+ * Checks the test cases from many threads at once and compares with a serial check.
+ *
+ * Every thread checks every case several times, in a different order, so the checks overlap
+ * and a shared traversal state would show up as a changed result.
+ *
+ * @param arrays The circuit vectors to check.
+ * @return True if every concurrent result matches the serial one.
+ */
+bool concurrent_check(std::vector<std::vector<int>>& arrays) {
+    std::vector<char> expected(arrays.size());
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        expected[i] = Check_Validity(arrays[i].size(), arrays[i].data());
+    }
+
+    int mismatches = 0;
+    int rounds = 200;
+    #pragma omp parallel for num_threads(8) reduction(+:mismatches)
+    for (int round = 0; round < rounds; ++round) {
+        std::vector<int> local;
+        for (size_t k = 0; k < arrays.size(); ++k) {
+            size_t i = (k * 7 + round) % arrays.size();
+            local = arrays[i];
+            if (Check_Validity(local.size(), local.data()) != static_cast<bool>(expected[i])) {
+                mismatches++;
+            }
+        }
+    }
+    if (mismatches == 0) {
+        std::cout << "concurrent Check_Validity: pass" << std::endl;
+    } else {
+        std::cout << "concurrent Check_Validity: fail - " << mismatches << " mismatches" << std::endl;
+    }
+    return mismatches == 0;
+}
+
+
+/**
+ * Compares the single-pass analysis with the separate checks.
+ *
+ * Checks the given circuits, every single-gene change of them, and random vectors, some of them
+ * with a truncated last unit, and expects the same code from Analyse_Validity, from a reused
+ * Circuit and from the separate checks.
+ *
+ * @param arrays The circuit vectors to start from.
+ * @return True if every code matches.
+ */
+bool analyse_check(std::vector<std::vector<int>>& arrays) {
+    std::vector<std::vector<int>> cases = arrays;
+    for (const std::vector<int>& array : arrays) {
+        int max_value = (array.size() - 1) / 3 + 2;
+        for (size_t gene = 0; gene < array.size(); ++gene) {
+            for (int value = -5; value <= max_value; ++value) {
+                std::vector<int> changed = array;
+                changed[gene] = value;
+                cases.push_back(changed);
+            }
+        }
+    }
+    std::mt19937 generator(19);
+    for (int i = 0; i < 20000; ++i) {
+        int num_units = 1 + generator() % 8;
+        int vector_size = 3 * num_units + 1 + (i % 10 == 0 ? 1 + generator() % 2 : 0);
+        std::vector<int> random(vector_size);
+        for (int& value : random) {
+            value = static_cast<int>(generator() % (num_units + 3));
+        }
+        random[0] = 0;
+        cases.push_back(random);
+    }
+
+    TestCircuit separate(3);
+    Circuit reused(1);
+    int mismatches = 0;
+    std::vector<int> counts(static_cast<int>(Validity_Code::bad_feed) + 1);
+    for (std::vector<int>& vector : cases) {
+        Validity_Code expected = separate.separate_checks_code(vector);
+        Validity_Code code = Analyse_Validity(vector.size(), vector.data());
+        counts[static_cast<int>(code)]++;
+        if (code != expected || reused.analyse(vector.size(), vector.data()) != expected ||
+            Check_Validity(vector.size(), vector.data()) != (expected == Validity_Code::valid)) {
+            mismatches++;
+        }
+    }
+    for (size_t code = 0; code < counts.size(); ++code) {
+        std::cout << Validity_Code_Name(static_cast<Validity_Code>(code)) << ": " << counts[code] << std::endl;
+    }
+
+    // The reasons for a few known circuits
+    int missing_unit[10] = {0, 1, 2, 2, 3, 0, 4, 0, 1, 1};
+    int bad_feed[10] = {10, 1, 2, 2, 3, 0, 4, 0, 1, 1};
+    int self_recycle[10] = {0, 0, 2, 3, 2, 0, 4, 1, 3, 0};
+    if (Analyse_Validity(10, missing_unit) != separate.separate_checks_code(std::vector<int>(missing_unit, missing_unit + 10)) ||
+        Analyse_Validity(10, bad_feed) != Validity_Code::missing_value ||
+        Analyse_Validity(10, self_recycle) == Validity_Code::valid) {
+        mismatches++;
+    }
+
+    if (mismatches == 0) {
+        std::cout << "Analyse_Validity: pass - " << cases.size() << " vectors" << std::endl;
+    } else {
+        std::cout << "Analyse_Validity: fail - " << mismatches << " mismatches" << std::endl;
+    }
+    return mismatches == 0;
+}
+
+
+/**
+ * Builds a valid chain: each unit sends its concentrate to the next and its intermediate back,
+ * and all tailings leave the circuit.
+ *
+ * @param num_units The number of units, at least 3.
+ * @return The circuit vector.
+ */
+std::vector<int> chain_circuit(int num_units) {
+    std::vector<int> vector(3 * num_units + 1);
+    for (int i = 0; i < num_units; ++i) {
+        vector[3 * i + 1] = i + 1;
+        vector[3 * i + 2] = i == 0 ? 2 : i - 1;
+        vector[3 * i + 3] = num_units + 1;
+    }
+    return vector;
+}
+
+/**
+ * Compares the outlets each unit reaches with a search from the unit itself, and checks that a
+ * long chain is neither too deep nor too slow to check.
+ *
+ * @param arrays The circuit vectors to check, each 3 * units + 1 long.
+ * @return True if every answer matches.
+ */
+bool outlets_check(std::vector<std::vector<int>>& arrays) {
+    Circuit circuit(1);
+    int mismatches = 0;
+    for (std::vector<int>& vector : arrays) {
+        int num_units = (vector.size() - 1) / 3;
+        bool all = true;
+        bool found = circuit.outlets_reachable(vector.size(), vector.data());
+        for (int start = 0; start < num_units; ++start) {
+            std::vector<char> seen(num_units, 0);
+            std::vector<int> stack = {start};
+            bool concentrate = false, tailings = false;
+            while (!stack.empty()) {
+                int unit = stack.back();
+                stack.pop_back();
+                if (seen[unit]) continue;
+                seen[unit] = 1;
+                for (int k = 1; k <= 3; ++k) {
+                    int next = vector[3 * unit + k];
+                    concentrate = concentrate || next == num_units;
+                    tailings = tailings || next == num_units + 1;
+                    if (next >= 0 && next < num_units) stack.push_back(next);
+                }
+            }
+            all = all && concentrate && tailings;
+            if (circuit.reaches_concentrate(start) != concentrate || circuit.reaches_tailings(start) != tailings) {
+                mismatches++;
+            }
+        }
+        if (found != all) {
+            mismatches++;
+        }
+    }
+
+    // Only the last unit of a chain feeds the concentrate outlet, but every unit reaches it. A chain
+    // this long would overflow the stack of a recursive traversal.
+    std::vector<int> chain = chain_circuit(200000);
+    if (!circuit.outlets_reachable(chain.size(), chain.data()) ||
+        Analyse_Validity(chain.size(), chain.data()) != Validity_Code::valid) {
+        mismatches++;
+    }
+    TestCircuit units(1);
+    units.set_units_from_vector(chain);
+    if (!units.test_is_reachable()) {
+        mismatches++;
+    }
+
+    // Cut the link into the last unit: the others still reach the tailings, but not the concentrate.
+    std::vector<int> dead_end = chain_circuit(5);
+    dead_end[3 * 3 + 1] = 2;
+    if (circuit.outlets_reachable(dead_end.size(), dead_end.data()) ||
+        circuit.reaches_concentrate(0) || circuit.reaches_concentrate(3) || !circuit.reaches_concentrate(4) ||
+        !circuit.reaches_tailings(0)) {
+        mismatches++;
+    }
+
+    if (mismatches == 0) {
+        std::cout << "outlets_reachable: pass" << std::endl;
+    } else {
+        std::cout << "outlets_reachable: fail - " << mismatches << " mismatches" << std::endl;
+    }
+    return mismatches == 0;
+}
+
+
+/**
+ * Checks that the structural pre-filter only rejects invalid circuits, catches the faults it is
+ * meant to, and that Check_Validity counts what it did.
+ *
+ * @param arrays The circuit vectors to check.
+ * @return True if every check passed.
+ */
+bool structural_filter_check(std::vector<std::vector<int>>& arrays) {
+    int failures = 0;
+    std::vector<std::vector<int>> cases = arrays;
+    for (const std::vector<int>& array : arrays) {
+        for (size_t gene = 0; gene < array.size(); ++gene) {
+            for (int value = -2; value <= (int) (array.size() - 1) / 3 + 2; ++value) {
+                std::vector<int> changed = array;
+                changed[gene] = value;
+                cases.push_back(changed);
+            }
+        }
+    }
+    long long rejected = 0;
+    for (std::vector<int>& vector : cases) {
+        Validity_Code fault = Structural_Filter(vector.size(), vector.data());
+        if (fault != Validity_Code::valid) {
+            rejected++;
+            if (Analyse_Validity(vector.size(), vector.data()) == Validity_Code::valid) {
+                failures++;
+            }
+        }
+    }
+
+    // Each fault on its own, in a valid ten-unit circuit
+    std::vector<int> circuit = {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2};
+    std::vector<int> feed = circuit, self = circuit, outlet = circuit, negative = circuit;
+    feed[0] = 10;
+    self[3 * 4 + 1] = 4;
+    outlet[2] = 10;
+    negative[3] = -3;
+    if (Structural_Filter(circuit.size(), circuit.data()) != Validity_Code::valid ||
+        Structural_Filter(feed.size(), feed.data()) != Validity_Code::bad_feed ||
+        Structural_Filter(self.size(), self.data()) != Validity_Code::self_recycle ||
+        Structural_Filter(outlet.size(), outlet.data()) != Validity_Code::misrouted_outlet ||
+        Structural_Filter(negative.size(), negative.data()) != Validity_Code::misrouted_outlet) {
+        failures++;
+    }
+
+    // The counters of this thread see every check
+    Collect_Validity_Statistics();
+    int checks = 3 * Validity_Statistics::sample_interval;
+    for (int i = 0; i < checks; ++i) {
+        std::vector<int>& vector = i % 3 == 0 ? circuit : i % 3 == 1 ? feed : self;
+        if (Check_Validity(vector.size(), vector.data()) != (i % 3 == 0)) {
+            failures++;
+        }
+    }
+    Validity_Statistics statistics = Collect_Validity_Statistics();
+    if (statistics.checks != checks || statistics.valid != checks / 3 || statistics.bad_feed != checks / 3 ||
+        statistics.self_recycle != checks / 3 || statistics.misrouted != 0 || statistics.timed != 3 ||
+        statistics.timed_rejections > statistics.timed || Collect_Validity_Statistics().checks != 0) {
+        failures++;
+    }
+
+    if (failures == 0) {
+        std::cout << "Structural_Filter: pass - rejected " << rejected << " of " << cases.size() << " vectors" << std::endl;
+    } else {
+        std::cout << "Structural_Filter: fail - " << failures << " failures" << std::endl;
+    }
+    return failures == 0;
+}
+
+
+/**
+ * @brief Tests that Random_Valid_Circuit builds only valid circuits.
+ *
+ * Circuits of many sizes are generated and checked with Analyse_Validity, and the smaller ones
+ * with the separate checks as well. Every destination should turn up at some gene, and sizes
+ * that allow no valid circuit are refused.
+ *
+ * @return True if the test passes, false otherwise.
+ */
+bool generator_check() {
+    std::mt19937 generator(23);
+    TestCircuit separate(3);
+    int failures = 0;
+    long long generated = 0;
+    for (int num_units : {2, 3, 5, 10, 42, 100, 1000}) {
+        int vector_size = 3 * num_units + 1;
+        std::vector<int> circuit(vector_size);
+        std::vector<char> seen(num_units + 2, 0);
+        int repeats = num_units <= 100 ? 2000 : 50;
+        for (int i = 0; i < repeats; ++i) {
+            if (!Random_Valid_Circuit(vector_size, circuit.data(), generator) ||
+                Analyse_Validity(vector_size, circuit.data()) != Validity_Code::valid ||
+                (num_units <= 100 && separate.separate_checks_code(circuit) != Validity_Code::valid)) {
+                failures++;
+            }
+            for (int value : circuit) {
+                seen[value] = 1;
+            }
+            generated++;
+        }
+        if (std::count(seen.begin(), seen.end(), 1) != num_units + 2) {
+            failures++;
+        }
+    }
+    std::vector<int> circuit(8);
+    if (Random_Valid_Circuit(4, circuit.data(), generator) || Random_Valid_Circuit(8, circuit.data(), generator)) {
+        failures++;
+    }
+
+    if (failures == 0) {
+        std::cout << "Random_Valid_Circuit: pass - " << generated << " circuits valid" << std::endl;
+    } else {
+        std::cout << "Random_Valid_Circuit: fail - " << failures << " failures" << std::endl;
+    }
+    return failures == 0;
+}
 
 /**
  * @brief Main function to run all test cases.
@@ -495,5 +837,22 @@ int main() {
     } else {
         std::cout << "Some extra tests failed!" << std::endl;
     }
+
+    // The circuits from the other tests, and the test cases if the file was found
+    std::vector<std::vector<int>> allArrays = {
+        {0, 1, 3, 2, 4, 4, 3, 1, 3, 6, 1, 1, 0, 5, 1, 1},
+        {0, 1, 9, 7, 4, 3, 2, 4, 8, 8, 4, 2, 2, 9, 0, 7, 10, 6, 8, 5, 4, 4, 2, 3, 11, 5, 1, 4, 5, 6, 2},
+        {0, 4, 1, 8, 12, 9, 17, 4, 3, 6, 8, 0, 18, 17, 12, 0, 7, 18, 13, 8, 12, 9, 16, 13, 9, 16, 3, 5, 15, 3, 21,
+         11, 16, 18, 20, 3, 0, 18, 2, 0, 16, 3, 6, 6, 9, 1, 10, 6, 19, 19, 0, 9, 1, 8, 7, 11, 16, 14, 1, 12, 3},
+        {0, 2, 2, 1, 3, 0, 4, 0, 0, 1},
+        {10, 1, 2, 2, 3, 0, 4, 0, 1, 1},
+        {0, 1, 1, 2, 3, 0, 1, 1, 1, 1},
+    };
+    allArrays.insert(allArrays.end(), validArrayColumn.begin(), validArrayColumn.end());
+    allArrays.insert(allArrays.end(), invalidArrayColumn.begin(), invalidArrayColumn.end());
+    if (!concurrent_check(allArrays) || !analyse_check(allArrays) || !outlets_check(allArrays) ||
+        !structural_filter_check(allArrays) || !generator_check()) {
+        return 1;
+    }
     return 0;
 }